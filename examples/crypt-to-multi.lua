@@ -19,21 +19,23 @@ seckey = octet.new()
 seckey:base64(keys.keyring.secret);
 keyring:private(seckey)
 
-res = {}
-
-pub = octet.new()
--- loop through all recipients
+-- import the public keys of all recipients
+pubkeys = {}
 for name,pubkey in pairs(keys.recipients) do
-   -- calculate the session key
-   pub:base64(pubkey)
-   k = keyring:session(pub)
-   if not k then
+   pubkeys[name] = octet.new()
+   pubkeys[name]:base64(pubkey)
+end
+
+-- calculate the session key with each recipient and encrypt the
+-- message with it, all in one call
+envelopes = keyring:encrypt_batch(pubkeys, secret)
+
+res = {}
+for name,enc in pairs(envelopes) do
+   if not enc then
 	  print( "Error: not a valid public key for recipient " .. name)
 	  return
    end
-
-   -- encrypt the message with the session key
-   enc = keyring:encrypt(k,secret)
    -- insert results in final json array
    res[name]= enc:base64()
 end
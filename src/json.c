@@ -37,6 +37,7 @@
  */
 
 #include <assert.h>
+#include <stdio.h>
 #include <string.h>
 #include <math.h>
 #include <limits.h>
@@ -46,6 +47,10 @@
 #include <json_strbuf.h>
 #include "json_fpconv.h"
 
+#include <zenroom.h>
+#include <zen_octet.h>
+#include <zen_codec.h>
+
 #ifndef CJSON_MODNAME
 #define CJSON_MODNAME   "cjson"
 #endif
@@ -136,12 +141,26 @@ typedef struct {
     int decode_max_depth;
 } json_config_t;
 
+/* Strings decoded into octets, see json_decode() */
+typedef enum {
+    O_NONE,
+    O_STRING,
+    O_BASE64,
+    O_HEX
+} json_octet_t;
+
+static const char *json_octet_name[] = {
+    "none", "string", "base64", "hex", NULL
+};
+
 typedef struct {
     const char *data;
     const char *ptr;
     strbuf_t *tmp;    /* Temporary storage for strings */
     json_config_t *cfg;
     int current_depth;
+    int map;          /* Stack index of the field map, 0 if none */
+    json_octet_t octet; /* Encoding of strings decoded into octets */
 } json_parse_t;
 
 typedef struct {
@@ -1145,13 +1164,47 @@ static void json_decode_descend(lua_State *l, json_parse_t *json, int slots)
         json->current_depth, json->ptr - json->data);
 }
 
+/* Look up the key on top of the stack in the field map at index map
+ * and set what applies to the value of the field. The entry found is
+ * pushed and must stay on the stack while the value is parsed. */
+static void json_field_map(lua_State *l, json_parse_t *json, int map)
+{
+    int i;
+
+    lua_pushvalue(l, -1);
+    lua_rawget(l, map);
+
+    json->map = 0;
+    json->octet = O_NONE;
+
+    switch (lua_type(l, -1)) {
+    case LUA_TNIL:
+        return;
+    case LUA_TTABLE:
+        json->map = lua_gettop(l);
+        return;
+    case LUA_TSTRING:
+        for (i = O_STRING; json_octet_name[i]; i++) {
+            if (!strcmp(lua_tostring(l, -1), json_octet_name[i])) {
+                json->octet = (json_octet_t)i;
+                return;
+            }
+        }
+    }
+
+    strbuf_free(json->tmp);
+    luaL_error(l, "Invalid field map entry for '%s'", lua_tostring(l, -2));
+}
+
 static void json_parse_object_context(lua_State *l, json_parse_t *json)
 {
     json_token_t token;
+    int map = json->map;
+    json_octet_t octet = json->octet;
 
-    /* 3 slots required:
-     * .., table, key, value */
-    json_decode_descend(l, json, 3);
+    /* 5 slots required:
+     * .., table, key, field map entry, value, octet metatable */
+    json_decode_descend(l, json, 5);
 
     lua_newtable(l);
 
@@ -1170,6 +1223,12 @@ static void json_parse_object_context(lua_State *l, json_parse_t *json)
         /* Push key */
         lua_pushlstring(l, token.value.string, token.string_len);
 
+        /* Members only take what the field map says about them */
+        if (map)
+            json_field_map(l, json, map);
+        else
+            json->octet = O_NONE;
+
         json_next_token(json, &token);
         if (token.type != T_COLON)
             json_throw_parse_error(l, json, "colon", &token);
@@ -1178,12 +1237,17 @@ static void json_parse_object_context(lua_State *l, json_parse_t *json)
         json_next_token(json, &token);
         json_process_value(l, json, &token);
 
+        if (map)
+            lua_remove(l, -2);
+
         /* Set key = value */
         lua_rawset(l, -3);
 
         json_next_token(json, &token);
 
         if (token.type == T_OBJ_END) {
+            json->map = map;
+            json->octet = octet;
             json_decode_ascend(json);
             return;
         }
@@ -1201,9 +1265,9 @@ static void json_parse_array_context(lua_State *l, json_parse_t *json)
     json_token_t token;
     int i;
 
-    /* 2 slots required:
-     * .., table, value */
-    json_decode_descend(l, json, 2);
+    /* 3 slots required:
+     * .., table, value, octet metatable */
+    json_decode_descend(l, json, 3);
 
     lua_newtable(l);
 
@@ -1233,13 +1297,62 @@ static void json_parse_array_context(lua_State *l, json_parse_t *json)
     }
 }
 
+/* Decode a string selected by the field map straight into an octet */
+static void json_push_octet(lua_State *l, json_parse_t *json,
+                            json_token_t *token)
+{
+    const char *str = token->value.string;
+    size_t len = token->string_len;
+    size_t size;
+    long res;
+    octet *o;
+
+    switch (json->octet) {
+    case O_BASE64:
+        size = B64_DECLEN(len);
+        break;
+    case O_HEX:
+        size = len / 2;
+        break;
+    default:
+        size = len;
+    }
+    if (size > MAX_FILE) {
+        strbuf_free(json->tmp);
+        luaL_error(l, "Octet too big (%d bytes) at character %d",
+                   (int)size, token->index + 1);
+    }
+
+    o = o_new(l, size ? (int)size : 1);
+    switch (json->octet) {
+    case O_BASE64:
+        res = zen_base64_decode((unsigned char *)o->val, o->max, str, len);
+        break;
+    case O_HEX:
+        res = zen_hex_decode((unsigned char *)o->val, o->max, str, len);
+        break;
+    default:
+        memcpy(o->val, str, len);
+        res = len;
+    }
+    if (res < 0) {
+        strbuf_free(json->tmp);
+        luaL_error(l, "Expected %s string but found invalid characters at character %d",
+                   json_octet_name[json->octet], token->index + 1);
+    }
+    o->len = res;
+}
+
 /* Handle the "value" context */
 static void json_process_value(lua_State *l, json_parse_t *json,
                                json_token_t *token)
 {
     switch (token->type) {
     case T_STRING:
-        lua_pushlstring(l, token->value.string, token->string_len);
+        if (json->octet)
+            json_push_octet(l, json, token);
+        else
+            lua_pushlstring(l, token->value.string, token->string_len);
         break;;
     case T_NUMBER:
         lua_pushnumber(l, token->value.number);
@@ -1263,18 +1376,34 @@ static void json_process_value(lua_State *l, json_parse_t *json,
     }
 }
 
+/* decode(json [, fieldmap]) where the optional field map tells which
+ * string fields to decode into octets, without making Lua strings of
+ * them. Its keys are member names, its values one of "base64", "hex"
+ * or "string" (raw bytes), or a nested field map for members which are
+ * objects. What a field map says about a member applies to each
+ * element when the member is an array, for instance:
+ *
+ *   json.decode(KEYS, { public = "base64", list = { hash = "hex" } }) */
 static int json_decode(lua_State *l)
 {
     json_parse_t json;
     json_token_t token;
     size_t json_len;
+    int nargs = lua_gettop(l);
 
-    luaL_argcheck(l, lua_gettop(l) == 1, 1, "expected 1 argument");
+    luaL_argcheck(l, nargs == 1 || nargs == 2, 1, "expected 1 or 2 arguments");
 
     json.cfg = json_fetch_config(l);
     json.data = luaL_checklstring(l, 1, &json_len);
     json.current_depth = 0;
     json.ptr = json.data;
+    json.map = 0;
+    json.octet = O_NONE;
+
+    if (nargs == 2 && !lua_isnil(l, 2)) {
+        luaL_checktype(l, 2, LUA_TTABLE);
+        json.map = 2;
+    }
 
     /* Detect Unicode other than UTF-8 (see RFC 4627, Sec 3)
      *
@@ -1303,6 +1432,608 @@ static int json_decode(lua_State *l)
     return 1;
 }
 
+/* ===== SELECT ===== */
+
+/* select(json, path, ...) returns for each path a table with the values
+ * it matches, in document order. All paths are matched in a single pass
+ * and only the matching values are turned into Lua data: everything
+ * else is checked by the parser and skipped, without allocations.
+ *
+ * Paths are a subset of JSONPath: "$" is the document, followed by any
+ * number of ".name", "['name']", "[n]" (counting from 0) and ".*" or
+ * "[*]" matching all members of an object or elements of an array. */
+
+#define JSON_SELECT_MAX 32  /* paths matched at once, one bit each */
+
+typedef enum {
+    P_KEY,
+    P_INDEX,
+    P_ANY
+} json_segment_type_t;
+
+typedef struct {
+    json_segment_type_t type;
+    const char *key;
+    size_t key_len;
+    int index;
+} json_segment_t;
+
+typedef struct {
+    json_segment_t *seg;
+    int len;
+} json_path_t;
+
+typedef struct {
+    json_path_t path[JSON_SELECT_MAX];
+    int found[JSON_SELECT_MAX];
+    int count;
+    int base;       /* stack index before the result tables */
+} json_select_t;
+
+/* Parse the path at stack index idx. The segments are kept in a
+ * userdata pushed on the stack and point inside the path string. */
+static void json_parse_path(lua_State *l, int idx, json_path_t *path)
+{
+    size_t len;
+    const char *str = luaL_checklstring(l, idx, &len);
+    const char *p = str, *end = str + len;
+    json_segment_t *seg;
+    char quote;
+
+    /* Each segment takes at least 2 characters */
+    path->seg = (json_segment_t *)lua_newuserdata(l, (len / 2 + 1) * sizeof(json_segment_t));
+    path->len = 0;
+
+    if (p == end || *p++ != '$')
+        goto invalid;
+
+    while (p < end) {
+        seg = &path->seg[path->len++];
+        if (*p == '.') {
+            p++;
+            if (p < end && *p == '*') {
+                seg->type = P_ANY;
+                p++;
+                continue;
+            }
+            seg->type = P_KEY;
+            seg->key = p;
+            while (p < end && *p != '.' && *p != '[')
+                p++;
+            seg->key_len = p - seg->key;
+            if (!seg->key_len)
+                goto invalid;
+            continue;
+        }
+
+        if (*p++ != '[' || p == end)
+            goto invalid;
+        if (*p == '*') {
+            seg->type = P_ANY;
+            p++;
+        } else if (*p == '\'' || *p == '"') {
+            quote = *p++;
+            seg->type = P_KEY;
+            seg->key = p;
+            while (p < end && *p != quote)
+                p++;
+            if (p == end)
+                goto invalid;
+            seg->key_len = p++ - seg->key;
+        } else {
+            seg->type = P_INDEX;
+            seg->index = 0;
+            if (*p < '0' || *p > '9')
+                goto invalid;
+            while (p < end && *p >= '0' && *p <= '9') {
+                if (seg->index > (INT_MAX - 9) / 10)
+                    goto invalid;
+                seg->index = seg->index * 10 + (*p++ - '0');
+            }
+        }
+        if (p == end || *p++ != ']')
+            goto invalid;
+    }
+    return;
+
+invalid:
+    luaL_error(l, "Invalid JSON path '%s' at character %d",
+               str, (int)(p - str));
+}
+
+/* Append the value on top of the stack to the results of path p */
+static void json_select_found(lua_State *l, json_select_t *sel, int p)
+{
+    lua_rawseti(l, sel->base + 1 + p, ++sel->found[p]);
+}
+
+/* Match the rest of path p inside a value already decoded at idx.
+ * Needed when a shorter path selected a value containing it. */
+static void json_select_table(lua_State *l, int idx, json_select_t *sel,
+                              int p, int depth)
+{
+    json_path_t *path = &sel->path[p];
+    json_segment_t *seg;
+    lua_Integer i, n;
+
+    if (depth == path->len) {
+        lua_pushvalue(l, idx);
+        json_select_found(l, sel, p);
+        return;
+    }
+    if (!lua_istable(l, idx))
+        return;
+
+    luaL_checkstack(l, 3, "JSON path too deep");
+    seg = &path->seg[depth];
+    switch (seg->type) {
+    case P_KEY:
+        lua_pushlstring(l, seg->key, seg->key_len);
+        lua_rawget(l, idx);
+        break;
+    case P_INDEX:
+        lua_rawgeti(l, idx, (lua_Integer)seg->index + 1);
+        break;
+    case P_ANY:
+        /* Arrays in order, objects in table order */
+        n = lua_rawlen(l, idx);
+        for (i = 1; i <= n; i++) {
+            lua_rawgeti(l, idx, i);
+            json_select_table(l, lua_gettop(l), sel, p, depth + 1);
+            lua_pop(l, 1);
+        }
+        if (!n) {
+            lua_pushnil(l);
+            while (lua_next(l, idx)) {
+                json_select_table(l, lua_gettop(l), sel, p, depth + 1);
+                lua_pop(l, 1);
+            }
+        }
+        return;
+    }
+    if (!lua_isnil(l, -1))
+        json_select_table(l, lua_gettop(l), sel, p, depth + 1);
+    lua_pop(l, 1);
+}
+
+/* Paths in mask whose segment at depth matches a key or an index */
+static unsigned int json_select_match(json_select_t *sel, unsigned int mask,
+                                      int depth, json_token_t *key, int index)
+{
+    unsigned int match = 0;
+    json_segment_t *seg;
+    int p;
+
+    for (p = 0; mask; p++, mask >>= 1) {
+        if (!(mask & 1))
+            continue;
+        seg = &sel->path[p].seg[depth];
+        if (seg->type == P_ANY ||
+            (key && seg->type == P_KEY && seg->key_len == (size_t)key->string_len &&
+             !memcmp(seg->key, key->value.string, seg->key_len)) ||
+            (!key && seg->type == P_INDEX && seg->index == index))
+            match |= 1u << p;
+    }
+
+    return match;
+}
+
+static void json_select_value(lua_State *l, json_parse_t *json,
+                              json_token_t *token, json_select_t *sel,
+                              unsigned int mask, int depth);
+
+static void json_select_object(lua_State *l, json_parse_t *json,
+                               json_select_t *sel, unsigned int mask,
+                               int depth)
+{
+    json_token_t token;
+    unsigned int match;
+
+    json_decode_descend(l, json, 3);
+
+    json_next_token(json, &token);
+
+    if (token.type == T_OBJ_END) {
+        json_decode_ascend(json);
+        return;
+    }
+
+    while (1) {
+        if (token.type != T_STRING)
+            json_throw_parse_error(l, json, "object key string", &token);
+
+        /* The key is only valid until the next token */
+        match = mask ? json_select_match(sel, mask, depth, &token, 0) : 0;
+
+        json_next_token(json, &token);
+        if (token.type != T_COLON)
+            json_throw_parse_error(l, json, "colon", &token);
+
+        json_next_token(json, &token);
+        json_select_value(l, json, &token, sel, match, depth + 1);
+
+        json_next_token(json, &token);
+
+        if (token.type == T_OBJ_END) {
+            json_decode_ascend(json);
+            return;
+        }
+
+        if (token.type != T_COMMA)
+            json_throw_parse_error(l, json, "comma or object end", &token);
+
+        json_next_token(json, &token);
+    }
+}
+
+static void json_select_array(lua_State *l, json_parse_t *json,
+                              json_select_t *sel, unsigned int mask,
+                              int depth)
+{
+    json_token_t token;
+    unsigned int match;
+    int i;
+
+    json_decode_descend(l, json, 3);
+
+    json_next_token(json, &token);
+
+    if (token.type == T_ARR_END) {
+        json_decode_ascend(json);
+        return;
+    }
+
+    for (i = 0; ; i++) {
+        match = mask ? json_select_match(sel, mask, depth, NULL, i) : 0;
+        json_select_value(l, json, &token, sel, match, depth + 1);
+
+        json_next_token(json, &token);
+
+        if (token.type == T_ARR_END) {
+            json_decode_ascend(json);
+            return;
+        }
+
+        if (token.type != T_COMMA)
+            json_throw_parse_error(l, json, "comma or array end", &token);
+
+        json_next_token(json, &token);
+    }
+}
+
+/* Like json_process_value(), but only decodes the values selected by
+ * the paths in mask, which all match the document down to depth */
+static void json_select_value(lua_State *l, json_parse_t *json,
+                              json_token_t *token, json_select_t *sel,
+                              unsigned int mask, int depth)
+{
+    unsigned int done = 0;
+    int p;
+
+    for (p = 0; p < sel->count; p++)
+        if ((mask & (1u << p)) && sel->path[p].len == depth)
+            done |= 1u << p;
+
+    if (done) {
+        json_process_value(l, json, token);
+        for (p = 0; p < sel->count; p++) {
+            if (done & (1u << p)) {
+                lua_pushvalue(l, -1);
+                json_select_found(l, sel, p);
+            } else if (mask & (1u << p)) {
+                json_select_table(l, lua_gettop(l), sel, p, depth);
+            }
+        }
+        lua_pop(l, 1);
+        return;
+    }
+
+    switch (token->type) {
+    case T_OBJ_BEGIN:
+        json_select_object(l, json, sel, mask, depth);
+        break;;
+    case T_ARR_BEGIN:
+        json_select_array(l, json, sel, mask, depth);
+        break;;
+    case T_STRING:
+    case T_NUMBER:
+    case T_BOOLEAN:
+    case T_NULL:
+        break;;
+    default:
+        json_throw_parse_error(l, json, "value", token);
+    }
+}
+
+static int json_select(lua_State *l)
+{
+    json_parse_t json;
+    json_token_t token;
+    json_select_t sel;
+    size_t json_len;
+    int p;
+
+    json.cfg = json_fetch_config(l);
+    json.data = luaL_checklstring(l, 1, &json_len);
+    json.current_depth = 0;
+    json.ptr = json.data;
+    json.map = 0;
+    json.octet = O_NONE;
+
+    sel.count = lua_gettop(l) - 1;
+    luaL_argcheck(l, sel.count >= 1, 2, "expected a JSON path");
+    luaL_argcheck(l, sel.count <= JSON_SELECT_MAX, JSON_SELECT_MAX + 2,
+                  "too many JSON paths");
+    luaL_checkstack(l, sel.count * 2 + 3, "too many JSON paths");
+
+    for (p = 0; p < sel.count; p++) {
+        json_parse_path(l, p + 2, &sel.path[p]);
+        sel.found[p] = 0;
+    }
+    sel.base = lua_gettop(l);
+    for (p = 0; p < sel.count; p++)
+        lua_newtable(l);
+
+    /* See json_decode() */
+    if (json_len >= 2 && (!json.data[0] || !json.data[1]))
+        luaL_error(l, "JSON parser does not support UTF-16 or UTF-32");
+
+    json.tmp = strbuf_new(json_len);
+
+    json_next_token(&json, &token);
+    json_select_value(l, &json, &token, &sel,
+                      0xffffffffu >> (JSON_SELECT_MAX - sel.count), 0);
+
+    json_next_token(&json, &token);
+
+    if (token.type != T_END)
+        json_throw_parse_error(l, &json, "the end", &token);
+
+    strbuf_free(json.tmp);
+
+    return sel.count;
+}
+
+/* ===== STREAMING DECODE ===== */
+
+/* decode_each(source, callback) decodes JSON read in chunks, so that
+ * input of any size can be processed with bounded memory.
+ *
+ * The source is a string, a file handle or a function returning
+ * chunks of text (nil at the end). When the input is a top level
+ * array the callback is called with each element and its index,
+ * otherwise with each value of a sequence of concatenated values (one
+ * object per line, for instance). Only the text of the value being
+ * decoded is kept in memory, which is then handed to the same parser
+ * used by decode().
+ *
+ * The callback can stop decoding by returning false. Returns the
+ * number of values decoded. */
+
+#define JSON_STREAM_CHUNK 4096
+
+typedef enum {
+    S_START,    /* before the first value */
+    S_ARRAY,    /* inside a top level array */
+    S_VALUES,   /* sequence of top level values */
+    S_DONE      /* top level array closed */
+} json_stream_state_t;
+
+typedef struct {
+    json_config_t *cfg;
+    json_stream_state_t state;
+    int depth;          /* nesting inside the current value */
+    int in_string;
+    int escape;
+    int comma;          /* a comma is waiting for the next element */
+    int stop;           /* the callback returned false */
+    lua_Integer count;
+    strbuf_t value;     /* text of the current value */
+    strbuf_t tmp;       /* decoded strings, see json_decode() */
+} json_stream_t;
+
+/* Decode the buffered value and pass it to the callback (stack index 2) */
+static void json_stream_emit(lua_State *l, json_stream_t *s)
+{
+    json_parse_t json;
+    json_token_t token;
+    int len;
+
+    strbuf_ensure_null(&s->value);
+    json.cfg = s->cfg;
+    json.data = strbuf_string(&s->value, &len);
+    json.ptr = json.data;
+    json.current_depth = 0;
+    json.map = 0;
+    json.octet = O_NONE;
+
+    /* Same sizing as decode(): the value bounds any string inside it */
+    strbuf_reset(&s->tmp);
+    strbuf_ensure_empty_length(&s->tmp, len);
+    json.tmp = &s->tmp;
+
+    json_next_token(&json, &token);
+    json_process_value(l, &json, &token);
+    json_next_token(&json, &token);
+    if (token.type != T_END)
+        json_throw_parse_error(l, &json, "the end", &token);
+
+    strbuf_reset(&s->value);
+    s->count++;
+
+    lua_pushvalue(l, 2);
+    lua_insert(l, -2);
+    lua_pushinteger(l, s->count);
+    lua_call(l, 2, 1);
+    if (lua_isboolean(l, -1) && !lua_toboolean(l, -1))
+        s->stop = 1;
+    lua_pop(l, 1);
+}
+
+static inline int json_stream_space(char c)
+{
+    return c == ' ' || c == '\t' || c == '\n' || c == '\r';
+}
+
+/* Scan a chunk tracking strings and nesting, emitting each value once
+ * its end is found. The state carries over between chunks. */
+static void json_stream_feed(lua_State *l, json_stream_t *s,
+                             const char *buf, size_t len)
+{
+    size_t i, start;
+    char c;
+
+    for (i = 0; i < len && !s->stop; i++) {
+        c = buf[i];
+
+        if (s->in_string) {
+            if (s->escape) {
+                s->escape = 0;
+                strbuf_append_char(&s->value, c);
+                continue;
+            }
+            /* Copy plain string content at once */
+            for (start = i; i < len && buf[i] != '"' && buf[i] != '\\'; i++)
+                ;
+            strbuf_append_mem(&s->value, buf + start, i - start);
+            if (i == len)
+                break;
+            c = buf[i];
+            strbuf_append_char(&s->value, c);
+            if (c == '\\') {
+                s->escape = 1;
+            } else {
+                s->in_string = 0;
+                if (!s->depth && s->state == S_VALUES)
+                    json_stream_emit(l, s);
+            }
+            continue;
+        }
+
+        if (json_stream_space(c)) {
+            if (s->depth)
+                strbuf_append_char(&s->value, c);
+            else if (strbuf_length(&s->value)) {
+                /* Ends a number or literal. Inside an array the
+                 * comma does, keep it so the parser rejects "[1 2]" */
+                if (s->state == S_VALUES)
+                    json_stream_emit(l, s);
+                else
+                    strbuf_append_char(&s->value, c);
+            }
+            continue;
+        }
+
+        if (s->state == S_START) {
+            if (c == '[') {
+                s->state = S_ARRAY;
+                continue;
+            }
+            s->state = S_VALUES;
+        } else if (s->state == S_DONE) {
+            luaL_error(l, "Expected the end but found '%c' after the array", c);
+        }
+
+        if (!s->depth && s->state == S_ARRAY && (c == ',' || c == ']')) {
+            if (strbuf_length(&s->value))
+                json_stream_emit(l, s);
+            else if (c == ',' || s->comma)
+                luaL_error(l, "Expected value but found '%c' at element %d",
+                           c, (int)s->count + 1);
+            s->comma = (c == ',');
+            if (c == ']')
+                s->state = S_DONE;
+            continue;
+        }
+
+        strbuf_append_char(&s->value, c);
+        if (c == '"') {
+            s->in_string = 1;
+        } else if (c == '{' || c == '[') {
+            s->depth++;
+        } else if ((c == '}' || c == ']') && s->depth) {
+            if (!--s->depth && s->state == S_VALUES)
+                json_stream_emit(l, s);
+        }
+    }
+}
+
+/* Reads the source (1) calling back (2) with the stream state (3).
+ * Runs protected so the buffers can be released on errors. */
+static int json_stream_run(lua_State *l)
+{
+    json_stream_t *s = (json_stream_t *)lua_touserdata(l, 3);
+    luaL_Stream *fh = (luaL_Stream *)luaL_testudata(l, 1, LUA_FILEHANDLE);
+    char chunk[JSON_STREAM_CHUNK];
+    const char *data;
+    size_t len;
+
+    if (lua_type(l, 1) == LUA_TSTRING) {
+        data = lua_tolstring(l, 1, &len);
+        json_stream_feed(l, s, data, len);
+    } else if (fh) {
+        if (!fh->closef)
+            luaL_error(l, "attempt to use a closed file");
+        while (!s->stop && (len = fread(chunk, 1, sizeof(chunk), fh->f)))
+            json_stream_feed(l, s, chunk, len);
+        if (ferror(fh->f))
+            luaL_error(l, "error reading JSON from file");
+    } else {
+        while (!s->stop) {
+            lua_pushvalue(l, 1);
+            lua_call(l, 0, 1);
+            if (lua_isnil(l, -1))
+                break;
+            if (lua_type(l, -1) != LUA_TSTRING)
+                luaL_error(l, "JSON source returned %s instead of a string",
+                           luaL_typename(l, -1));
+            data = lua_tolstring(l, -1, &len);
+            json_stream_feed(l, s, data, len);
+            lua_pop(l, 1);
+        }
+    }
+
+    if (!s->stop) {
+        if (s->in_string || s->depth || s->state == S_ARRAY)
+            luaL_error(l, "Expected more input but found the end at element %d",
+                       (int)s->count + 1);
+        if (strbuf_length(&s->value))
+            json_stream_emit(l, s);
+    }
+
+    lua_pushinteger(l, s->count);
+    return 1;
+}
+
+static int json_decode_each(lua_State *l)
+{
+    json_stream_t s;
+    int err;
+
+    if (lua_type(l, 1) != LUA_TSTRING && !luaL_testudata(l, 1, LUA_FILEHANDLE))
+        luaL_checktype(l, 1, LUA_TFUNCTION);
+    luaL_checktype(l, 2, LUA_TFUNCTION);
+    lua_settop(l, 2);
+
+    memset(&s, 0, sizeof(s));
+    s.cfg = json_fetch_config(l);
+    s.state = S_START;
+    strbuf_init(&s.value, 0);
+    strbuf_init(&s.tmp, 0);
+
+    lua_pushcfunction(l, json_stream_run);
+    lua_insert(l, 1);
+    lua_pushlightuserdata(l, &s);
+    err = lua_pcall(l, 3, 1, 0);
+
+    strbuf_free(&s.value);
+    strbuf_free(&s.tmp);
+    if (err)
+        return lua_error(l);
+
+    return 1;
+}
+
 /* ===== INITIALISATION ===== */
 
 #if !defined(LUA_VERSION_NUM) || LUA_VERSION_NUM < 502
@@ -1331,14 +2062,18 @@ static void luaL_setfuncs (lua_State *l, const luaL_Reg *reg, int nup)
 static int json_protect_conversion(lua_State *l)
 {
     int err;
+    int nargs = lua_gettop(l);
+    int max_args = lua_tointeger(l, lua_upvalueindex(2));
 
-    /* Deliberately throw an error for invalid arguments */
-    luaL_argcheck(l, lua_gettop(l) == 1, 1, "expected 1 argument");
+    /* Deliberately throw an error for invalid arguments.
+     * upvalue(2) is the number of arguments accepted */
+    luaL_argcheck(l, nargs >= 1 && nargs <= max_args, 1,
+                  max_args > 1 ? "expected 1 or 2 arguments" : "expected 1 argument");
 
     /* pcall() the function stored as upvalue(1) */
     lua_pushvalue(l, lua_upvalueindex(1));
     lua_insert(l, 1);
-    err = lua_pcall(l, 1, 1, 0);
+    err = lua_pcall(l, nargs, 1, 0);
     if (!err)
         return 1;
 
@@ -1359,6 +2094,8 @@ int lua_cjson_new(lua_State *l)
     luaL_Reg reg[] = {
         { "encode", json_encode },
         { "decode", json_decode },
+        { "decode_each", json_decode_each },
+        { "select", json_select },
         { "encode_sparse_array", json_cfg_encode_sparse_array },
         { "encode_max_depth", json_cfg_encode_max_depth },
         { "decode_max_depth", json_cfg_decode_max_depth },
@@ -1397,6 +2134,7 @@ int lua_cjson_new(lua_State *l)
 int lua_cjson_safe_new(lua_State *l)
 {
     const char *func[] = { "decode", "encode", NULL };
+    const int func_nargs[] = { 2, 1 };
     int i;
 
     lua_cjson_new(l);
@@ -1407,7 +2145,8 @@ int lua_cjson_safe_new(lua_State *l)
 
     for (i = 0; func[i]; i++) {
         lua_getfield(l, -1, func[i]);
-        lua_pushcclosure(l, json_protect_conversion, 1);
+        lua_pushinteger(l, func_nargs[i]);
+        lua_pushcclosure(l, json_protect_conversion, 2);
         lua_setfield(l, -2, func[i]);
     }
 
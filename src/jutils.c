@@ -39,7 +39,7 @@
 		  ci sono le funzioni chiamate */
 #define WARN 1 /* ... blkbblbl */
 
-char msg[MAX_STRING];
+ZEN_TLS char msg[MAX_STRING];
 
 static int verbosity = 1;
 
@@ -29,6 +29,7 @@
  */
 
 #include <stdio.h>
+#include <string.h>
 
 #include <umm_malloc.h>
 #include <umm_malloc_cfg.h>
@@ -46,8 +47,8 @@
 /* ------------------------------------------------------------------------- */
 
 UMM_H_ATTPACKPRE typedef struct umm_ptr_t {
-  unsigned short int next;
-  unsigned short int prev;
+  umm_blockno next;
+  umm_blockno prev;
 } UMM_H_ATTPACKSUF umm_ptr;
 
 
@@ -61,21 +62,51 @@ UMM_H_ATTPACKPRE typedef struct umm_block_t {
   } body;
 } UMM_H_ATTPACKSUF umm_block;
 
+#ifdef UMM_BLOCKS_32
+#define UMM_FREELIST_MASK (0x80000000)
+#define UMM_BLOCKNO_MASK  (0x7FFFFFFF)
+#define UMM_REGION_MAX    ((size_t)1 << 30) /* 1GiB */
+#else
 #define UMM_FREELIST_MASK (0x8000)
 #define UMM_BLOCKNO_MASK  (0x7FFF)
+#define UMM_REGION_MAX    (UMM_BLOCKNO_MASK * sizeof(umm_block))
+#endif
 
 /* -------------------------------------------------------------- */
 #include <zenroom.h>
 
-// globals for umm
-static umm_block *umm_heap;
-static size_t umm_numblocks = 0;
-static UMM_HEAP_INFO ummHeapInfo;
+/*
+ * State of one heap, kept at the head of the memory area passed to
+ * umm_init() and followed by the blocks: there are no globals, so any
+ * number of heaps can be used at once (one per zenroom context), each
+ * by one thread at a time.
+ *
+ * A heap made growable by umm_growable() is a chain of regions, each
+ * one a complete umm heap with its own state: the first region is the
+ * heap handle passed to all calls and holds the growth settings, new
+ * regions are appended when no region has room for an allocation.
+ */
+typedef struct umm_state_t {
+  umm_block *heap;
+  size_t numblocks;
+  size_t size; /* bytes of the whole region */
+  UMM_HEAP_INFO info;
+  struct umm_state_t *next; /* next region of a growable heap */
+
+  /* first region only */
+  void *(*grow)(size_t);
+  void (*release)(void *);
+  size_t size_total; /* bytes in all regions */
+  size_t size_max; /* limit to size_total */
+} umm_state;
+
+#define UMM_STATE_BLOCKS \
+  ((sizeof(umm_state) + sizeof(umm_block) - 1) / sizeof(umm_block))
 
 /* -------------------------------------------------------------- */
 
-#define UMM_NUMBLOCKS (umm_numblocks)
-#define UMM_BLOCK(b)  (umm_heap[b])
+#define UMM_NUMBLOCKS (H->numblocks)
+#define UMM_BLOCK(b)  (H->heap[b])
 #define UMM_NBLOCK(b) (UMM_BLOCK(b).header.used.next)
 #define UMM_PBLOCK(b) (UMM_BLOCK(b).header.used.prev)
 #define UMM_NFREE(b)  (UMM_BLOCK(b).body.free.next)
@@ -96,7 +127,7 @@ static UMM_HEAP_INFO ummHeapInfo;
 
 /* ------------------------------------------------------------------------ */
 
-static unsigned short int umm_blocks( size_t size ) {
+static umm_blockno umm_blocks( size_t size ) {
 
   /*
    * The calculation of the block size is not too difficult, but there are
@@ -129,9 +160,9 @@ static unsigned short int umm_blocks( size_t size ) {
  *
  * Note that free pointers are NOT modified by this function.
  */
-static void umm_split_block( unsigned short int c,
-    unsigned short int blocks,
-    unsigned short int new_freemask ) {
+static void umm_split_block( umm_state *H, umm_blockno c,
+    umm_blockno blocks,
+    umm_blockno new_freemask ) {
 
   UMM_NBLOCK(c+blocks) = (UMM_NBLOCK(c) & UMM_BLOCKNO_MASK) | new_freemask;
   UMM_PBLOCK(c+blocks) = c;
@@ -142,7 +173,7 @@ static void umm_split_block( unsigned short int c,
 
 /* ------------------------------------------------------------------------ */
 
-static void umm_disconnect_from_free_list( unsigned short int c ) {
+static void umm_disconnect_from_free_list( umm_state *H, umm_blockno c ) {
   /* Disconnect this block from the FREE list */
 
   UMM_NFREE(UMM_PFREE(c)) = UMM_NFREE(c);
@@ -158,7 +189,7 @@ static void umm_disconnect_from_free_list( unsigned short int c ) {
  * have the UMM_FREELIST_MASK bit set!
  */
 
-static void umm_assimilate_up( unsigned short int c ) {
+static void umm_assimilate_up( umm_state *H, umm_blockno c ) {
 
   if( UMM_NBLOCK(UMM_NBLOCK(c)) & UMM_FREELIST_MASK ) {
     /*
@@ -170,7 +201,7 @@ static void umm_assimilate_up( unsigned short int c ) {
 
     /* Disconnect the next block from the FREE list */
 
-    umm_disconnect_from_free_list( UMM_NBLOCK(c) );
+    umm_disconnect_from_free_list( H, UMM_NBLOCK(c) );
 
     /* Assimilate the next block with this one */
 
@@ -184,7 +215,7 @@ static void umm_assimilate_up( unsigned short int c ) {
  * have the UMM_FREELIST_MASK bit set!
  */
 
-static unsigned short int umm_assimilate_down( unsigned short int c, unsigned short int freemask ) {
+static umm_blockno umm_assimilate_down( umm_state *H, umm_blockno c, umm_blockno freemask ) {
 
   UMM_NBLOCK(UMM_PBLOCK(c)) = UMM_NBLOCK(c) | freemask;
   UMM_PBLOCK(UMM_NBLOCK(c)) = UMM_PBLOCK(c);
@@ -200,21 +231,28 @@ void umm_memzero(char *ptr, size_t s) {
 }
 
 void umm_init( void *ptr, size_t memsize ) {
-  /* init heap pointer and size, and memset it to 0 */
-  umm_heap = (umm_block *)ptr; // saves only zen_mem_t->heap
-  umm_numblocks = (memsize / sizeof(umm_block));
-  act(0, "HEAP memory allocated: %u KiB",memsize/1024);
-  func(0, "UMM blocks available: %u", umm_numblocks);
+  umm_state *H = (umm_state *)ptr;
+  /* memset the area to 0, then init heap pointer and size */
   umm_memzero((char*)ptr,memsize);
+  H->heap = (umm_block *)ptr + UMM_STATE_BLOCKS;
+  H->numblocks = (memsize / sizeof(umm_block)) - UMM_STATE_BLOCKS;
+  H->size = memsize;
+  H->next = NULL;
+  H->grow = NULL;
+  H->release = NULL;
+  H->size_total = memsize;
+  H->size_max = memsize;
+  act(0, "HEAP memory allocated: %u KiB",memsize/1024);
+  func(0, "UMM blocks available: %u", H->numblocks);
 
   /* setup initial blank heap structure */
   {
     /* index of the 0th `umm_block` */
-    const unsigned short int block_0th = 0;
+    const umm_blockno block_0th = 0;
     /* index of the 1st `umm_block` */
-    const unsigned short int block_1th = 1;
+    const umm_blockno block_1th = 1;
     /* index of the latest `umm_block` */
-    const unsigned short int block_last = UMM_NUMBLOCKS - 1;
+    const umm_blockno block_last = UMM_NUMBLOCKS - 1;
 
     /* setup the 0th `umm_block`, which just points to the 1st */
     UMM_NBLOCK(block_0th) = block_1th;
@@ -259,9 +297,9 @@ void umm_init( void *ptr, size_t memsize ) {
 
 /* ------------------------------------------------------------------------ */
 
-void umm_free( void *ptr ) {
+static void umm_free_region( umm_state *H, void *ptr ) {
 
-  unsigned short int c;
+  umm_blockno c;
 
   /* If we're being asked to free a NULL pointer, well that's just silly! */
 
@@ -285,13 +323,13 @@ void umm_free( void *ptr ) {
 
   /* Figure out which block we're in. Note the use of truncated division... */
 
-  c = (((char *)ptr)-(char *)(&(umm_heap[0])))/sizeof(umm_block);
+  c = (((char *)ptr)-(char *)(&(H->heap[0])))/sizeof(umm_block);
 
   DBGLOG_DEBUG( "Freeing block %6i\n", c );
 
   /* Now let's assimilate this block with the next one if possible. */
 
-  umm_assimilate_up( c );
+  umm_assimilate_up( H, c );
 
   /* Then assimilate with the previous block if possible */
 
@@ -299,7 +337,7 @@ void umm_free( void *ptr ) {
 
     DBGLOG_DEBUG( "Assimilate down to next block, which is FREE\n" );
 
-    c = umm_assimilate_down(c, UMM_FREELIST_MASK);
+    c = umm_assimilate_down(H, c, UMM_FREELIST_MASK);
   } else {
     /*
      * The previous block is not a free block, so add this one to the head
@@ -322,14 +360,14 @@ void umm_free( void *ptr ) {
 
 /* ------------------------------------------------------------------------ */
 
-void *umm_malloc( size_t size ) {
-  unsigned short int blocks;
-  unsigned short int blockSize = 0;
+static void *umm_malloc_region( umm_state *H, size_t size ) {
+  umm_blockno blocks;
+  umm_blockno blockSize = 0;
 
-  unsigned short int bestSize;
-  unsigned short int bestBlock;
+  umm_blockno bestSize;
+  umm_blockno bestBlock;
 
-  unsigned short int cf;
+  umm_blockno cf;
 
   // if (umm_heap == NULL) {
   //   umm_init();
@@ -364,7 +402,7 @@ void *umm_malloc( size_t size ) {
   cf = UMM_NFREE(0);
 
   bestBlock = UMM_NFREE(0);
-  bestSize  = 0x7FFF;
+  bestSize  = UMM_BLOCKNO_MASK;
 
   while( cf ) {
     blockSize = (UMM_NBLOCK(cf) & UMM_BLOCKNO_MASK) - cf;
@@ -387,7 +425,7 @@ void *umm_malloc( size_t size ) {
     cf = UMM_NFREE(cf);
   }
 
-  if( 0x7FFF != bestSize ) {
+  if( UMM_BLOCKNO_MASK != bestSize ) {
     cf        = bestBlock;
     blockSize = bestSize;
   }
@@ -406,7 +444,7 @@ void *umm_malloc( size_t size ) {
 
       /* Disconnect this block from the FREE list */
 
-      umm_disconnect_from_free_list( cf );
+      umm_disconnect_from_free_list( H, cf );
 
     } else {
       /* It's not an exact fit and we need to split off a block. */
@@ -416,7 +454,7 @@ void *umm_malloc( size_t size ) {
        * split current free block `cf` into two blocks. The first one will be
        * returned to user, so it's not free, and the second one will be free.
        */
-      umm_split_block( cf, blocks, UMM_FREELIST_MASK /*new block is free*/ );
+      umm_split_block( H, cf, blocks, UMM_FREELIST_MASK /*new block is free*/ );
 
       /*
        * `umm_split_block()` does not update the free pointers (it affects
@@ -452,14 +490,18 @@ void *umm_malloc( size_t size ) {
 
 /* ------------------------------------------------------------------------ */
 
-void *umm_realloc( void *ptr, size_t size ) {
+/*
+ * H is the region of ptr, R the first region: when no adjacent block
+ * is free, the new block can come from any region.
+ */
+static void *umm_realloc_region( umm_state *R, umm_state *H, void *ptr, size_t size ) {
 
-  unsigned short int blocks;
-  unsigned short int blockSize;
-  unsigned short int prevBlockSize = 0;
-  unsigned short int nextBlockSize = 0;
+  umm_blockno blocks;
+  umm_blockno blockSize;
+  umm_blockno prevBlockSize = 0;
+  umm_blockno nextBlockSize = 0;
 
-  unsigned short int c;
+  umm_blockno c;
 
   size_t curSize;
 
@@ -478,7 +520,7 @@ void *umm_realloc( void *ptr, size_t size ) {
   if( ((void *)NULL == ptr) ) {
     DBGLOG_DEBUG( "realloc the NULL pointer - call malloc()\n" );
 
-    return( umm_malloc(size) );
+    return( umm_malloc(R, size) );
   }
 
   /*
@@ -490,7 +532,7 @@ void *umm_realloc( void *ptr, size_t size ) {
   if( 0 == size ) {
     DBGLOG_DEBUG( "realloc to 0 size, just free the block\n" );
 
-    umm_free( ptr );
+    umm_free_region( H, ptr );
 
     return( (void *)NULL );
   }
@@ -508,7 +550,7 @@ void *umm_realloc( void *ptr, size_t size ) {
 
   /* Figure out which block we're in. Note the use of truncated division... */
 
-  c = (((char *)ptr)-(char *)(&(umm_heap[0])))/sizeof(umm_block);
+  c = (((char *)ptr)-(char *)(&(H->heap[0])))/sizeof(umm_block);
 
   /* Figure out how big this block is ... the free bit is not set :-) */
 
@@ -568,30 +610,30 @@ void *umm_realloc( void *ptr, size_t size ) {
         /* This space intentionally left blank */
     } else if ((blockSize + nextBlockSize) >= blocks) {
         DBGLOG_DEBUG( "realloc using next block - %i\n", blocks );
-        umm_assimilate_up( c );
+        umm_assimilate_up( H, c );
         blockSize += nextBlockSize;
     } else if ((prevBlockSize + blockSize) >= blocks) {
         DBGLOG_DEBUG( "realloc using prev block - %i\n", blocks );
-        umm_disconnect_from_free_list( UMM_PBLOCK(c) );
-        c = umm_assimilate_down(c, 0);
+        umm_disconnect_from_free_list( H, UMM_PBLOCK(c) );
+        c = umm_assimilate_down(H, c, 0);
         memmove( (void *)&UMM_DATA(c), ptr, curSize );
         ptr = (void *)&UMM_DATA(c);
         blockSize += prevBlockSize;
     } else if ((prevBlockSize + blockSize + nextBlockSize) >= blocks) {
         DBGLOG_DEBUG( "realloc using prev and next block - %i\n", blocks );
-        umm_assimilate_up( c );
-        umm_disconnect_from_free_list( UMM_PBLOCK(c) );
-        c = umm_assimilate_down(c, 0);
+        umm_assimilate_up( H, c );
+        umm_disconnect_from_free_list( H, UMM_PBLOCK(c) );
+        c = umm_assimilate_down(H, c, 0);
         memmove( (void *)&UMM_DATA(c), ptr, curSize );
         ptr = (void *)&UMM_DATA(c);
         blockSize += (prevBlockSize + nextBlockSize);
     } else {
         DBGLOG_DEBUG( "realloc a completely new block %i\n", blocks );
         void *oldptr = ptr;
-        if( (ptr = umm_malloc( size )) ) {
+        if( (ptr = umm_malloc( R, size )) ) {
             DBGLOG_DEBUG( "realloc %i to a bigger block %i, copy, and free the old\n", blockSize, blocks );
             memcpy( ptr, oldptr, curSize );
-            umm_free( oldptr );
+            umm_free_region( H, oldptr );
         } else {
             DBGLOG_DEBUG( "realloc %i to a bigger block %i failed - return NULL and leave the old block!\n", blockSize, blocks );
             /* This space intentionally left blnk */
@@ -605,8 +647,8 @@ void *umm_realloc( void *ptr, size_t size ) {
 
     if (blockSize > blocks ) {
         DBGLOG_DEBUG( "split and free %i blocks from %i\n", blocks, blockSize );
-        umm_split_block( c, blocks, 0 );
-        umm_free( (void *)&UMM_DATA(c+blocks) );
+        umm_split_block( H, c, blocks, 0 );
+        umm_free_region( H, (void *)&UMM_DATA(c+blocks) );
     }
 
     /* Release the critical section... */
@@ -617,10 +659,10 @@ void *umm_realloc( void *ptr, size_t size ) {
 
 /* ------------------------------------------------------------------------ */
 
-void *umm_calloc( size_t num, size_t item_size ) {
+void *umm_calloc( void *heap, size_t num, size_t item_size ) {
   void *ret;
 
-  ret = umm_malloc((size_t)(item_size * num));
+  ret = umm_malloc(heap, (size_t)(item_size * num));
 
   if (ret)
       umm_memzero(ret, (size_t)(item_size * num));
@@ -630,19 +672,20 @@ void *umm_calloc( size_t num, size_t item_size ) {
 
 /* ------------------------------------------------------------------------ */
 
-void *umm_info( void *ptr) {
+/* fills H->info, returns ptr when it is a free block of the region */
+static void *umm_info_region( umm_state *H, void *ptr ) {
 
-  unsigned short int blockNo = 0;
+  umm_blockno blockNo = 0;
 
   /* Protect the critical section... */
   UMM_CRITICAL_ENTRY();
 
   /*
-   * Clear out all of the entries in the ummHeapInfo structure before doing
+   * Clear out all of the entries in the H->info structure before doing
    * any calculations..
    */
 
-  umm_memzero( (char*)&ummHeapInfo, sizeof( ummHeapInfo ) );
+  umm_memzero( (char*)&H->info, sizeof( H->info ) );
 
   // DBGLOG_FORCE( force, "+----------+-------+--------+--------+-------+--------+--------+\n" );
   // DBGLOG_FORCE( force, "|0x%08lx|B %5i|NB %5i|PB %5i|Z %5i|NF %5i|PF %5i|\n",
@@ -665,17 +708,17 @@ void *umm_info( void *ptr) {
   while( UMM_NBLOCK(blockNo) & UMM_BLOCKNO_MASK ) {
     size_t curBlocks = (UMM_NBLOCK(blockNo) & UMM_BLOCKNO_MASK )-blockNo;
 
-    ++ummHeapInfo.totalEntries;
-    ummHeapInfo.totalBlocks += curBlocks;
+    ++H->info.totalEntries;
+    H->info.totalBlocks += curBlocks;
 
     /* Is this a free block? */
 
     if( UMM_NBLOCK(blockNo) & UMM_FREELIST_MASK ) {
-      ++ummHeapInfo.freeEntries;
-      ummHeapInfo.freeBlocks += curBlocks;
+      ++H->info.freeEntries;
+      H->info.freeBlocks += curBlocks;
 
-      if (ummHeapInfo.maxFreeContiguousBlocks < curBlocks) {
-        ummHeapInfo.maxFreeContiguousBlocks = curBlocks;
+      if (H->info.maxFreeContiguousBlocks < curBlocks) {
+        H->info.maxFreeContiguousBlocks = curBlocks;
       }
 
       // DBGLOG_FORCE( force, "|0x%08lx|B %5i|NB %5i|PB %5i|Z %5u|NF %5i|PF %5i|\n",
@@ -697,8 +740,8 @@ void *umm_info( void *ptr) {
         return( ptr );
       }
     } else {
-      ++ummHeapInfo.usedEntries;
-      ummHeapInfo.usedBlocks += curBlocks;
+      ++H->info.usedEntries;
+      H->info.usedBlocks += curBlocks;
 
       // DBGLOG_FORCE( force, "|0x%08lx|B %5i|NB %5i|PB %5i|Z %5u|\n",
       //     (unsigned long)(&UMM_BLOCK(blockNo)),
@@ -718,11 +761,11 @@ void *umm_info( void *ptr) {
 
   {
     size_t curBlocks = UMM_NUMBLOCKS-blockNo;
-    ummHeapInfo.freeBlocks  += curBlocks;
-    ummHeapInfo.totalBlocks += curBlocks;
+    H->info.freeBlocks  += curBlocks;
+    H->info.totalBlocks += curBlocks;
 
-    if (ummHeapInfo.maxFreeContiguousBlocks < curBlocks) {
-      ummHeapInfo.maxFreeContiguousBlocks = curBlocks;
+    if (H->info.maxFreeContiguousBlocks < curBlocks) {
+      H->info.maxFreeContiguousBlocks = curBlocks;
     }
   }
 
@@ -735,21 +778,6 @@ void *umm_info( void *ptr) {
   //     UMM_NFREE(blockNo),
   //     UMM_PFREE(blockNo) );
 
-  act(0, "Total Entries %5i \t Used Entries %5i \t Free Entries %5i",
-      ummHeapInfo.totalEntries,
-      ummHeapInfo.usedEntries,
-      ummHeapInfo.freeEntries );
-
-  act(0, "Total Blocks  %5i \t Used Blocks  %5i \t Free Blocks  %5i",
-      ummHeapInfo.totalBlocks,
-      ummHeapInfo.usedBlocks,
-      ummHeapInfo.freeBlocks  );
-
-  size_t totmem = ummHeapInfo.totalBlocks * sizeof(umm_block);
-  size_t freemem = ummHeapInfo.freeBlocks * sizeof(umm_block);
-  size_t usedmem = ummHeapInfo.usedBlocks * sizeof(umm_block);
-  act(0, "Total Memory %u KiB \t Used Memory %u KiB \t Free Memory %u KiB",
-      totmem/1024, usedmem/1024, freemem/1024);
   /* Release the critical section... */
   UMM_CRITICAL_EXIT();
 
@@ -778,10 +806,10 @@ void *umm_info( void *ptr) {
  * This way, we ensure that the free flag is in sync with the free pointers
  * chain.
  */
-int umm_integrity_check() {
+static int umm_integrity_region( umm_state *H ) {
 	int ok = 1;
-	unsigned short int prev;
-	unsigned short int cur;
+	umm_blockno prev;
+	umm_blockno cur;
 
 	/* Iterate through all free blocks */
 	prev = 0;
@@ -876,3 +904,215 @@ clean:
 	}
 	return ok;
 }
+
+/* ------------------------------------------------------------------------ */
+
+/* region of the heap containing ptr, NULL if none */
+static umm_state *umm_region( umm_state *R, void *ptr ) {
+  umm_state *H;
+  for( H = R; H; H = H->next )
+    if( (char *)ptr >= (char *)H->heap
+        && (char *)ptr < (char *)(H->heap + H->numblocks) )
+      return( H );
+  return( NULL );
+}
+
+/*
+ * Appends a region with room for size bytes. Each new region is as big
+ * as the whole heap so far (the heap doubles) within the limits of
+ * UMM_REGION_MAX and of size_max.
+ */
+static umm_state *umm_grow( umm_state *R, size_t size ) {
+  umm_state *H, *L;
+  size_t need = ( (size_t)umm_blocks( size ) + UMM_STATE_BLOCKS + 2 )
+    * sizeof(umm_block);
+  size_t memsize = R->size_total;
+
+  if( !R->grow || R->size_total >= R->size_max )
+    return( NULL );
+  if( memsize < need ) memsize = need;
+  if( memsize > UMM_REGION_MAX ) memsize = UMM_REGION_MAX;
+  if( memsize > R->size_max - R->size_total )
+    memsize = R->size_max - R->size_total;
+  if( memsize < need )
+    return( NULL );
+
+  H = (umm_state *)(*R->grow)( memsize );
+  if( !H )
+    return( NULL );
+  umm_init( H, memsize );
+  for( L = R; L->next; L = L->next ) ;
+  L->next = H;
+  R->size_total += memsize;
+  func(0, "HEAP grown by %u KiB to %u KiB",
+       memsize/1024, R->size_total/1024);
+  return( H );
+}
+
+void umm_growable( void *heap, void *(*grow)(size_t), void (*release)(void *),
+                   size_t size_max ) {
+  umm_state *R = (umm_state *)heap;
+  R->grow = grow;
+  R->release = release;
+  R->size_max = size_max > R->size_total ? size_max : R->size_total;
+}
+
+void umm_release( void *heap ) {
+  umm_state *R = (umm_state *)heap;
+  umm_state *H = R->next;
+  R->next = NULL;
+  while( H ) {
+    umm_state *next = H->next;
+    (*R->release)( H );
+    H = next;
+  }
+  R->size_total = R->size;
+}
+
+/* ------------------------------------------------------------------------ */
+
+void *umm_malloc( void *heap, size_t size ) {
+  umm_state *R = (umm_state *)heap;
+  umm_state *H;
+  void *ptr;
+
+  /* bigger sizes would overflow the block count */
+  if( 0 == size || size >= UMM_REGION_MAX )
+    return( (void *)NULL );
+
+  for( H = R; H; H = H->next )
+    if( (ptr = umm_malloc_region( H, size )) )
+      return( ptr );
+
+  if( (H = umm_grow( R, size )) )
+    return( umm_malloc_region( H, size ) );
+
+  return( (void *)NULL );
+}
+
+void umm_free( void *heap, void *ptr ) {
+  umm_state *H;
+
+  if( (void *)0 == ptr )
+    return;
+
+  H = umm_region( (umm_state *)heap, ptr );
+  if( !H ) {
+    error(0, "%s: pointer %p is not in the heap", __func__, ptr);
+    return;
+  }
+  umm_free_region( H, ptr );
+}
+
+void *umm_realloc( void *heap, void *ptr, size_t size ) {
+  umm_state *R = (umm_state *)heap;
+  umm_state *H;
+
+  if( (void *)0 == ptr )
+    return( umm_malloc( heap, size ) );
+
+  if( size >= UMM_REGION_MAX )
+    return( (void *)NULL );
+
+  H = umm_region( R, ptr );
+  if( !H ) {
+    error(0, "%s: pointer %p is not in the heap", __func__, ptr);
+    return( (void *)NULL );
+  }
+  return( umm_realloc_region( R, H, ptr, size ) );
+}
+
+void *umm_info( void *heap, void *ptr ) {
+  umm_state *H;
+  size_t totalEntries = 0, usedEntries = 0, freeEntries = 0;
+  size_t totalBlocks = 0, usedBlocks = 0, freeBlocks = 0;
+  unsigned int regions = 0;
+
+  for( H = (umm_state *)heap; H; H = H->next ) {
+    if( ptr && umm_info_region( H, ptr ) )
+      return( ptr );
+    if( !ptr )
+      umm_info_region( H, NULL );
+    totalEntries += H->info.totalEntries;
+    usedEntries  += H->info.usedEntries;
+    freeEntries  += H->info.freeEntries;
+    totalBlocks  += H->info.totalBlocks;
+    usedBlocks   += H->info.usedBlocks;
+    freeBlocks   += H->info.freeBlocks;
+    regions++;
+  }
+
+  act(0, "Total Entries %5u \t Used Entries %5u \t Free Entries %5u",
+      totalEntries, usedEntries, freeEntries );
+
+  act(0, "Total Blocks  %5u \t Used Blocks  %5u \t Free Blocks  %5u",
+      totalBlocks, usedBlocks, freeBlocks );
+
+  act(0, "Total Memory %u KiB \t Used Memory %u KiB \t Free Memory %u KiB",
+      (totalBlocks * sizeof(umm_block))/1024,
+      (usedBlocks * sizeof(umm_block))/1024,
+      (freeBlocks * sizeof(umm_block))/1024);
+  if( regions > 1 )
+    act(0, "Heap regions %u (limit %u KiB)", regions,
+        ((umm_state *)heap)->size_max/1024);
+
+  return( NULL );
+}
+
+int umm_integrity_check( void *heap ) {
+  umm_state *H;
+  for( H = (umm_state *)heap; H; H = H->next )
+    if( !umm_integrity_region( H ) )
+      return( 0 );
+  return( 1 );
+}
+
+/* ------------------------------------------------------------------------ */
+
+/*
+ * Images of the heap: all regions copied one after the other. Regions
+ * are only ever appended, so the ones present when an image was saved
+ * are still the first ones of the chain when it is loaded back and
+ * those appended since are released.
+ */
+size_t umm_image_size( void *heap ) {
+  return( ((umm_state *)heap)->size_total );
+}
+
+void umm_image_save( void *heap, void *dst ) {
+  umm_state *H;
+  char *p = (char *)dst;
+  for( H = (umm_state *)heap; H; H = H->next ) {
+    memcpy( p, H, H->size );
+    p += H->size;
+  }
+}
+
+void umm_image_load( void *heap, const void *src, size_t len ) {
+  umm_state *R = (umm_state *)heap;
+  umm_state *H, *next;
+  const char *p = (const char *)src;
+  size_t size, pos = 0;
+
+  for( H = R; H; H = H->next ) {
+    pos += H->size;
+    if( pos >= len ) break;
+  }
+  if( H && H->next ) {
+    next = H->next;
+    H->next = NULL;
+    while( next ) {
+      H = next->next;
+      (*R->release)( next );
+      next = H;
+    }
+  }
+
+  /* the image carries the same chain of regions */
+  for( H = R; H && p < (const char *)src + len; H = next ) {
+    size = H->size;
+    memcpy( H, p, size );
+    next = H->next;
+    p += size;
+  }
+}
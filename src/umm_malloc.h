@@ -10,11 +10,25 @@
 
 /* ------------------------------------------------------------------------ */
 
-void  umm_init( void*, size_t );
-void *umm_malloc( size_t size );
-void *umm_calloc( size_t num, size_t size );
-void *umm_realloc( void *ptr, size_t size );
-void  umm_free( void *ptr );
+/* the heap argument is the memory area initialised by umm_init() */
+
+void  umm_init( void *heap, size_t memsize );
+void *umm_malloc( void *heap, size_t size );
+void *umm_calloc( void *heap, size_t num, size_t size );
+void *umm_realloc( void *heap, void *ptr, size_t size );
+void  umm_free( void *heap, void *ptr );
+
+/* growth of a heap by new regions, up to size_max bytes in total */
+
+void  umm_growable( void *heap, void *(*grow)(size_t), void (*release)(void *),
+                    size_t size_max );
+void  umm_release( void *heap );
+
+/* images of a heap and of all its regions */
+
+size_t umm_image_size( void *heap );
+void   umm_image_save( void *heap, void *dst );
+void   umm_image_load( void *heap, const void *src, size_t len );
 
 
 /* ------------------------------------------------------------------------ */
@@ -54,6 +54,22 @@
 #define UMM_BEST_FIT
 #undef  UMM_FIRST_FIT
 
+/*
+ * -D UMM_BLOCKS_32 :
+ *
+ * Uses 32 bit block numbers instead of the 16 bit ones of the original
+ * umm_malloc. Each heap region is then limited to 1GiB instead of
+ * 256KiB, which is also the biggest allocation a growing heap can
+ * serve, at the cost of twice the block overhead (16 bytes instead of
+ * 8). A heap bigger than a region grows by chaining regions anyway.
+ */
+
+#ifdef UMM_BLOCKS_32
+typedef unsigned int umm_blockno;
+#else
+typedef unsigned short int umm_blockno;
+#endif
+
 /*
  * -D UMM_INFO :
  *
@@ -62,20 +78,20 @@
  * unallocated block on the heap!
  */
   typedef struct UMM_HEAP_INFO_t {
-    unsigned short int totalEntries;
-    unsigned short int usedEntries;
-    unsigned short int freeEntries;
+    umm_blockno totalEntries;
+    umm_blockno usedEntries;
+    umm_blockno freeEntries;
 
-    unsigned short int totalBlocks;
-    unsigned short int usedBlocks;
-    unsigned short int freeBlocks;
+    umm_blockno totalBlocks;
+    umm_blockno usedBlocks;
+    umm_blockno freeBlocks;
 
-    unsigned short int maxFreeContiguousBlocks;
+    umm_blockno maxFreeContiguousBlocks;
   }
   UMM_HEAP_INFO;
 
-  void *umm_info( void *ptr );
-  size_t umm_free_heap_size( void );
+  void *umm_info( void *heap, void *ptr );
+  size_t umm_free_heap_size( void *heap );
 
 /*
  * A couple of macros to make it easier to protect the memory allocator
@@ -107,12 +123,12 @@
 #define UMM_INTEGRITY_CHECK
 
 #ifdef UMM_INTEGRITY_CHECK
-   int umm_integrity_check( void );
-#  define INTEGRITY_CHECK() umm_integrity_check()
+   int umm_integrity_check( void *heap );
+#  define INTEGRITY_CHECK(heap) umm_integrity_check(heap)
    extern void umm_corruption(void);
 #  define UMM_HEAP_CORRUPTION_CB() printf( "Heap Corruption!" )
 #else
-#  define INTEGRITY_CHECK() 0
+#  define INTEGRITY_CHECK(heap) 0
 #endif
 
 /*
@@ -0,0 +1,186 @@
+/*  Zenroom (DECODE project)
+ *
+ *  (c) Copyright 2017-2018 Dyne.org foundation
+ *  designed, written and maintained by Denis Roio <jaromil@dyne.org>
+ *
+ * This source code is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Public License as published
+ * by the Free Software Foundation; either version 3 of the License,
+ * or (at your option) any later version.
+ *
+ * This source code is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * Please refer to the GNU Public License for more details.
+ *
+ * You should have received a copy of the GNU Public License along with
+ * this source code; if not, write to:
+ * Free Software Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+
+// Arena for the payload of octets selected with conf "arena". Scripts
+// create many short lived octets (conversions, concatenations, xor)
+// and each would cost an allocation and a free of its payload in the
+// heap: with the arena payloads are taken from chunks by moving a
+// pointer and are all released at once when the execution ends.
+//
+// Each payload is preceded by a header pointing to the reference
+// holding it (the val of an octet). When the octet is collected its
+// payload is only marked as dead. At the end of an execution, after
+// a full GC, the payloads still referenced by live octets are copied
+// to the heap and their reference updated, then the arena is emptied.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <jutils.h>
+#include <zenroom.h>
+#include <zen_arena.h>
+
+typedef struct {
+	void **ref; // where the payload pointer is held, NULL when dead
+	size_t size;
+} arena_hdr_t;
+
+#define ARENA_ALIGN(s) (((s) + 15) & ~(size_t)15)
+#define ARENA_HDR ARENA_ALIGN(sizeof(arena_hdr_t))
+
+static zen_arena_chunk_t *arena_chunk(zen_mem_t *mem) {
+	zen_arena_chunk_t *c = (*mem->malloc)(mem->heap, ARENA_CHUNK);
+	if(!c) return NULL;
+	c->next = NULL;
+	c->pos = (char*)c + sizeof(zen_arena_chunk_t);
+	c->end = (char*)c + ARENA_CHUNK;
+	return c;
+}
+
+// the arena state lives in the heap, so it is part of heap snapshots
+int zen_arena_init(zen_mem_t *mem) {
+	zen_arena_t *A = (*mem->malloc)(mem->heap, sizeof(zen_arena_t));
+	if(!A) {
+		error(NULL, "%s: cannot allocate arena", __func__);
+		return 0; }
+	memset(A, 0, sizeof(zen_arena_t));
+	A->chunks = arena_chunk(mem);
+	if(!A->chunks) {
+		(*mem->free)(mem->heap, A);
+		error(NULL, "%s: cannot allocate arena", __func__);
+		return 0; }
+	mem->arena = A;
+	act(NULL, "ARENA for octets up to %u bytes", ARENA_MAX);
+	return 1;
+}
+
+// returns NULL when the caller should allocate in the heap instead
+void *zen_arena_alloc(zen_mem_t *mem, void **ref, size_t size) {
+	zen_arena_t *A = (zen_arena_t*)mem->arena;
+	zen_arena_chunk_t *c;
+	arena_hdr_t *h;
+	size_t need = ARENA_HDR + ARENA_ALIGN(size);
+	if(!A || size > ARENA_MAX) return NULL;
+	c = A->chunks;
+	if(c->pos + need > c->end) {
+		c = arena_chunk(mem);
+		if(!c) return NULL;
+		c->next = A->chunks;
+		A->chunks = c;
+	}
+	h = (arena_hdr_t*)c->pos;
+	h->ref = ref;
+	h->size = size;
+	c->pos += need;
+	A->allocs++;
+	A->used += need;
+	if(A->used > A->peak) A->peak = A->used;
+	return (char*)h + ARENA_HDR;
+}
+
+// header of the payload at ptr, NULL if not in the arena
+static arena_hdr_t *arena_hdr(zen_arena_t *A, void *ptr) {
+	zen_arena_chunk_t *c;
+	if(!A || !ptr) return NULL;
+	for(c = A->chunks; c; c = c->next)
+		if((char*)ptr > (char*)c && (char*)ptr < c->pos)
+			return (arena_hdr_t*)((char*)ptr - ARENA_HDR);
+	return NULL;
+}
+
+// returns 1 if ptr is a payload of the arena, now marked as dead
+int zen_arena_free(zen_mem_t *mem, void *ptr) {
+	arena_hdr_t *h = arena_hdr((zen_arena_t*)mem->arena, ptr);
+	if(!h) return 0;
+	h->ref = NULL;
+	return 1;
+}
+
+// moves a payload to the heap right away, to be called before its
+// address is shared (octet views) since a reset would move it.
+// Returns 0 when out of memory.
+int zen_arena_promote(zen_mem_t *mem, void **ref) {
+	zen_arena_t *A = (zen_arena_t*)mem->arena;
+	arena_hdr_t *h = arena_hdr(A, *ref);
+	void *dst;
+	if(!h) return 1;
+	dst = (*mem->malloc)(mem->heap, h->size);
+	if(!dst) return 0;
+	memcpy(dst, *ref, h->size);
+	h->ref = NULL;
+	*ref = dst;
+	A->promoted++;
+	return 1;
+}
+
+// to be called after a full GC, so that only payloads of reachable
+// octets are still referenced and need to be moved to the heap
+void zen_arena_reset(zen_mem_t *mem) {
+	zen_arena_t *A = (zen_arena_t*)mem->arena;
+	zen_arena_chunk_t *c, *next;
+	char *p;
+	if(!A || !A->used) return;
+	for(c = A->chunks; c; c = c->next) {
+		for(p = (char*)c + sizeof(zen_arena_chunk_t); p < c->pos; ) {
+			arena_hdr_t *h = (arena_hdr_t*)p;
+			if(h->ref) {
+				void *dst = (*mem->malloc)(mem->heap, h->size);
+				if(!dst) {
+					// cannot move it: keep this chunk
+					error(NULL, "%s: out of memory promoting %u bytes",
+					      __func__, h->size);
+					return; }
+				memcpy(dst, p + ARENA_HDR, h->size);
+				*h->ref = dst;
+				h->ref = NULL;
+				A->promoted++;
+			}
+			p += ARENA_HDR + ARENA_ALIGN(h->size);
+		}
+	}
+	// keep only the last chunk, which is the oldest
+	for(c = A->chunks; c->next; c = next) {
+		next = c->next;
+		(*mem->free)(mem->heap, c);
+	}
+	c->pos = (char*)c + sizeof(zen_arena_chunk_t);
+	A->chunks = c;
+	A->used = 0;
+	A->resets++;
+}
+
+void zen_arena_report(zen_mem_t *mem) {
+	zen_arena_t *A = (zen_arena_t*)mem->arena;
+	act(NULL, "ARENA %lu octets allocated, peak %u KiB, %lu resets, %lu promoted to the heap",
+	    A->allocs, A->peak/1024, A->resets, A->promoted);
+}
+
+// to be called after lua_close, when no octet is alive anymore
+void zen_arena_teardown(zen_mem_t *mem) {
+	zen_arena_t *A = (zen_arena_t*)mem->arena;
+	zen_arena_chunk_t *c, *next;
+	for(c = A->chunks; c; c = next) {
+		next = c->next;
+		(*mem->free)(mem->heap, c);
+	}
+	(*mem->free)(mem->heap, A);
+	mem->arena = NULL;
+}
@@ -0,0 +1,36 @@
+#ifndef __ZEN_ARENA_H__
+#define __ZEN_ARENA_H__
+
+#include <zenroom.h>
+
+// bump allocator for the payload of octets, reset at the end of each
+// script execution by zen_exec_script()
+
+#define ARENA_CHUNK 16384 // size of chunks taken from the heap
+#define ARENA_MAX   8192  // bigger payloads go to the heap
+
+typedef struct zen_arena_chunk_t {
+	struct zen_arena_chunk_t *next;
+	char *pos; // first free byte
+	char *end;
+	char pad[8]; // keeps the data following aligned to 16 bytes
+} zen_arena_chunk_t;
+
+typedef struct {
+	zen_arena_chunk_t *chunks; // the first is the one in use
+	unsigned long allocs;
+	unsigned long promoted; // payloads moved to the heap on reset
+	unsigned long resets;
+	size_t used; // bytes allocated since the last reset
+	size_t peak; // highest value of used
+} zen_arena_t;
+
+int   zen_arena_init(zen_mem_t *mem);
+void *zen_arena_alloc(zen_mem_t *mem, void **ref, size_t size);
+int   zen_arena_free(zen_mem_t *mem, void *ptr);
+int   zen_arena_promote(zen_mem_t *mem, void **ref);
+void  zen_arena_reset(zen_mem_t *mem);
+void  zen_arena_report(zen_mem_t *mem);
+void  zen_arena_teardown(zen_mem_t *mem);
+
+#endif
@@ -74,6 +74,7 @@ zenroom_t *ast_init(char *script) {
 	Z->stderr_buf = NULL;
 	Z->stderr_pos = 0;
 	Z->stderr_len = 0;
+	Z->random = NULL;
 	Z->userdata = NULL;
 	//Set zenroom context as a global in lua
 	//this will be freed on lua_close
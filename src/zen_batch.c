@@ -0,0 +1,210 @@
+/*  Zenroom (DECODE project)
+ *
+ *  (c) Copyright 2017-2018 Dyne.org foundation
+ *  designed, written and maintained by Denis Roio <jaromil@dyne.org>
+ *
+ * This source code is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Public License as published
+ * by the Free Software Foundation; either version 3 of the License,
+ * or (at your option) any later version.
+ *
+ * This source code is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * Please refer to the GNU Public License for more details.
+ *
+ * You should have received a copy of the GNU Public License along with
+ * this source code; if not, write to:
+ * Free Software Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+
+// Batch executor: runs an array of jobs on a number of worker threads,
+// each owning a pool of one context which is reset between jobs.
+//
+// Jobs are split in contiguous ranges, one per worker. A worker takes
+// jobs from the head of its own range and once that is empty steals
+// from the tail of the range with most jobs left, so that a few slow
+// jobs do not leave the other threads idle.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#if !defined(__EMSCRIPTEN__)
+#include <pthread.h>
+#endif
+
+#include <jutils.h>
+#include <zenroom.h>
+
+typedef struct {
+#if !defined(__EMSCRIPTEN__)
+	pthread_t thread;
+	pthread_mutex_t lock;
+#endif
+	int head; // next job to take
+	int tail; // end of range (excluded)
+	unsigned long stolen;
+	struct batch_t *batch;
+} batch_worker_t;
+
+typedef struct batch_t {
+	zen_job_t *jobs;
+	char *conf;
+	int nworkers;
+	batch_worker_t *workers;
+} batch_t;
+
+static void batch_run_job(zen_pool_t *P, zen_job_t *job) {
+	double start = dtime();
+	job->return_code =
+		zenroom_pool_exec_tobuf(P, job->script, job->keys, job->data,
+		                        job->stdout_buf, job->stdout_len,
+		                        job->stderr_buf, job->stderr_len);
+	job->time = dtime() - start;
+}
+
+#if defined(__EMSCRIPTEN__)
+
+// no threads: run all jobs in sequence on a single context
+static int batch_execute(batch_t *B, int njobs) {
+	int c;
+	zen_pool_t *P = zen_pool_init(B->conf, 1);
+	if(!P) return 1;
+	for(c=0; c<njobs; c++)
+		batch_run_job(P, &B->jobs[c]);
+	zen_pool_teardown(P);
+	B->nworkers = 1;
+	return 0;
+}
+
+#else
+
+// returns the index of the next job for worker w, -1 when all done
+static int batch_next(batch_t *B, batch_worker_t *w) {
+	int c = -1;
+	pthread_mutex_lock(&w->lock);
+	if(w->head < w->tail) c = w->head++;
+	pthread_mutex_unlock(&w->lock);
+	if(c >= 0) return c;
+
+	// steal from the tail of the busiest worker
+	while(1) {
+		int i, left, most = 0;
+		batch_worker_t *victim = NULL;
+		for(i=0; i<B->nworkers; i++) {
+			batch_worker_t *v = &B->workers[i];
+			if(v == w) continue;
+			pthread_mutex_lock(&v->lock);
+			left = v->tail - v->head;
+			pthread_mutex_unlock(&v->lock);
+			if(left > most) { most = left; victim = v; }
+		}
+		if(!victim) return -1;
+		pthread_mutex_lock(&victim->lock);
+		if(victim->head < victim->tail) c = --victim->tail;
+		pthread_mutex_unlock(&victim->lock);
+		if(c >= 0) {
+			w->stolen++;
+			return c; }
+		// range emptied meanwhile, look again
+	}
+}
+
+static void *batch_worker(void *arg) {
+	batch_worker_t *w = (batch_worker_t*)arg;
+	batch_t *B = w->batch;
+	int c;
+	// each thread creates its own context, which also makes its
+	// memory manager the active one in this thread
+	zen_pool_t *P = zen_pool_init(B->conf, 1);
+	if(!P) {
+		error(NULL, "%s: context initialisation failed", __func__);
+		return NULL; }
+	while((c = batch_next(B, w)) >= 0)
+		batch_run_job(P, &B->jobs[c]);
+	zen_pool_teardown(P);
+	return NULL;
+}
+
+static int batch_execute(batch_t *B, int njobs) {
+	int c, started = 0;
+	int range = njobs / B->nworkers;
+	int rest  = njobs % B->nworkers;
+	int pos = 0;
+	for(c=0; c<B->nworkers; c++) {
+		batch_worker_t *w = &B->workers[c];
+		w->batch = B;
+		w->stolen = 0;
+		w->head = pos;
+		pos += range + (c < rest ? 1 : 0);
+		w->tail = pos;
+		pthread_mutex_init(&w->lock, NULL);
+	}
+	for(c=0; c<B->nworkers; c++) {
+		if(pthread_create(&B->workers[c].thread, NULL,
+		                  batch_worker, &B->workers[c])) {
+			error(NULL, "%s: cannot start thread %i", __func__, c);
+			break; }
+		started++;
+	}
+	for(c=0; c<started; c++)
+		pthread_join(B->workers[c].thread, NULL);
+	for(c=0; c<B->nworkers; c++)
+		pthread_mutex_destroy(&B->workers[c].lock);
+	B->nworkers = started;
+	return started ? 0 : 1;
+}
+
+#endif
+
+int zenroom_exec_batch(zen_job_t *jobs, int njobs, char *conf,
+                       int nthreads, int verbosity,
+                       zen_batch_stats_t *stats) {
+	batch_t B;
+	int c, failed = 0;
+	unsigned long stolen = 0;
+	if(!jobs || njobs < 1) {
+		error(NULL, "%s: no jobs to execute", __func__);
+		return 0; }
+	set_debug(verbosity);
+
+	if(nthreads <= 0) {
+#if defined(_SC_NPROCESSORS_ONLN)
+		nthreads = (int)sysconf(_SC_NPROCESSORS_ONLN);
+#endif
+		if(nthreads <= 0) nthreads = 1;
+	}
+	if(nthreads > njobs) nthreads = njobs;
+
+	for(c=0; c<njobs; c++) {
+		jobs[c].return_code = 1; // error by default
+		jobs[c].time = 0.0;
+	}
+	B.jobs = jobs;
+	B.conf = conf;
+	B.nworkers = nthreads;
+	B.workers = calloc(nthreads, sizeof(batch_worker_t));
+
+	double start = dtime();
+	batch_execute(&B, njobs);
+	double elapsed = dtime() - start;
+
+	for(c=0; c<B.nworkers; c++)
+		stolen += B.workers[c].stolen;
+	for(c=0; c<njobs; c++)
+		if(jobs[c].return_code) failed++;
+	notice(NULL, "Batch of %i jobs on %i threads completed in %.3f secs (%.1f jobs/s), %i failed, %lu stolen",
+	       njobs, B.nworkers, elapsed, njobs / elapsed, failed, stolen);
+	if(stats) {
+		stats->jobs = njobs;
+		stats->failed = failed;
+		stats->threads = B.nworkers;
+		stats->stolen = stolen;
+		stats->elapsed = elapsed;
+		stats->throughput = njobs / elapsed;
+	}
+	free(B.workers);
+	return failed;
+}
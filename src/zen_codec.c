@@ -0,0 +1,429 @@
+/*  Zenroom (DECODE project)
+ *
+ *  (c) Copyright 2017-2018 Dyne.org foundation
+ *  designed, written and maintained by Denis Roio <jaromil@dyne.org>
+ *
+ * This source code is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Public License as published
+ * by the Free Software Foundation; either version 3 of the License,
+ * or (at your option) any later version.
+ *
+ * This source code is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * Please refer to the GNU Public License for more details.
+ *
+ * You should have received a copy of the GNU Public License along with
+ * this source code; if not, write to:
+ * Free Software Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+
+// Base64 and hex encoders and decoders for octets. Decoders validate
+// and convert in a single pass: the vector loops classify a block of
+// chars and convert it at once, stopping at the first block holding
+// anything else than plain digits (including base64 padding), which
+// is left to the scalar loop to convert or to report as invalid.
+//
+// The vector algorithms are those by Wojciech Muła and Daniel Lemire
+// (http://0x80.pl/articles/index.html#base64-algorithm-new).
+
+#include <string.h>
+
+#include <zen_codec.h>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__)) \
+	&& !defined(__EMSCRIPTEN__)
+#define CODEC_X86
+#include <immintrin.h>
+#define SSSE3 __attribute__((target("ssse3")))
+#define AVX2  __attribute__((target("avx2")))
+#endif
+
+static const char b64_enc[] =
+	"ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+static const char hex_enc[] = "0123456789abcdef";
+
+// value of base64 and hex digits, -1 for other chars
+static const signed char b64_dec[256] = {
+	-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+	-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+	-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, 62, -1, -1, -1, 63,
+	52, 53, 54, 55, 56, 57, 58, 59, 60, 61, -1, -1, -1, -1, -1, -1,
+	-1,  0,  1,  2,  3,  4,  5,  6,  7,  8,  9, 10, 11, 12, 13, 14,
+	15, 16, 17, 18, 19, 20, 21, 22, 23, 24, 25, -1, -1, -1, -1, -1,
+	-1, 26, 27, 28, 29, 30, 31, 32, 33, 34, 35, 36, 37, 38, 39, 40,
+	41, 42, 43, 44, 45, 46, 47, 48, 49, 50, 51, -1, -1, -1, -1, -1,
+	-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+	-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+	-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+	-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+	-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+	-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+	-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+	-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1
+};
+static const signed char hex_dec[256] = {
+	-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+	-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+	-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+	 0,  1,  2,  3,  4,  5,  6,  7,  8,  9, -1, -1, -1, -1, -1, -1,
+	-1, 10, 11, 12, 13, 14, 15, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+	-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+	-1, 10, 11, 12, 13, 14, 15, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+	-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+	-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+	-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+	-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+	-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+	-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+	-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+	-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+	-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1
+};
+
+// vector kernels: convert whole blocks and return the amount of
+// input consumed
+typedef struct {
+	const char *name;
+	size_t (*b64enc)(char *dst, const unsigned char *src, size_t len);
+	size_t (*b64dec)(unsigned char *dst, size_t max, const char *src, size_t len);
+	size_t (*hexenc)(char *dst, const unsigned char *src, size_t len);
+	size_t (*hexdec)(unsigned char *dst, size_t max, const char *src, size_t len);
+} codec_t;
+
+static size_t none_enc(char *dst, const unsigned char *src, size_t len) {
+	(void)dst; (void)src; (void)len; return 0; }
+static size_t none_dec(unsigned char *dst, size_t max, const char *src, size_t len) {
+	(void)dst; (void)max; (void)src; (void)len; return 0; }
+
+static const codec_t codec_scalar = {
+	"scalar", none_enc, none_dec, none_enc, none_dec };
+
+#ifdef CODEC_X86
+
+// x >= lo && x <= hi on unsigned bytes
+#define RANGE128(x,lo,hi) \
+	_mm_and_si128(_mm_cmpeq_epi8(_mm_max_epu8(x, _mm_set1_epi8(lo)), x), \
+	              _mm_cmpeq_epi8(_mm_min_epu8(x, _mm_set1_epi8(hi)), x))
+#define RANGE256(x,lo,hi) \
+	_mm256_and_si256(_mm256_cmpeq_epi8(_mm256_max_epu8(x, _mm256_set1_epi8(lo)), x), \
+	                 _mm256_cmpeq_epi8(_mm256_min_epu8(x, _mm256_set1_epi8(hi)), x))
+
+SSSE3 static size_t hexenc_ssse3(char *dst, const unsigned char *src, size_t len) {
+	const __m128i lut = _mm_loadu_si128((const __m128i*)hex_enc);
+	const __m128i mask = _mm_set1_epi8(0x0f);
+	size_t i;
+	for(i=0; i+16 <= len; i+=16) {
+		__m128i v  = _mm_loadu_si128((const __m128i*)(src+i));
+		__m128i hi = _mm_shuffle_epi8(lut, _mm_and_si128(_mm_srli_epi16(v, 4), mask));
+		__m128i lo = _mm_shuffle_epi8(lut, _mm_and_si128(v, mask));
+		_mm_storeu_si128((__m128i*)(dst+2*i),    _mm_unpacklo_epi8(hi, lo));
+		_mm_storeu_si128((__m128i*)(dst+2*i+16), _mm_unpackhi_epi8(hi, lo));
+	}
+	return i;
+}
+
+SSSE3 static size_t hexdec_ssse3(unsigned char *dst, size_t max, const char *src, size_t len) {
+	const __m128i weights = _mm_set1_epi16(0x0110); // 16 * high + low
+	size_t i;
+	for(i=0; i+32 <= len && i/2+16 <= max; i+=32) {
+		__m128i c[2], v[2], ok;
+		int k;
+		c[0] = _mm_loadu_si128((const __m128i*)(src+i));
+		c[1] = _mm_loadu_si128((const __m128i*)(src+i+16));
+		ok = _mm_set1_epi8(-1);
+		for(k=0; k<2; k++) {
+			__m128i l  = _mm_or_si128(c[k], _mm_set1_epi8(0x20));
+			__m128i md = RANGE128(c[k], '0', '9');
+			__m128i ml = RANGE128(l, 'a', 'f');
+			ok = _mm_and_si128(ok, _mm_or_si128(md, ml));
+			v[k] = _mm_or_si128(
+				_mm_and_si128(md, _mm_sub_epi8(c[k], _mm_set1_epi8('0'))),
+				_mm_and_si128(ml, _mm_sub_epi8(l, _mm_set1_epi8('a'-10))));
+		}
+		if(_mm_movemask_epi8(ok) != 0xFFFF) break;
+		_mm_storeu_si128((__m128i*)(dst+i/2),
+		                 _mm_packus_epi16(_mm_maddubs_epi16(v[0], weights),
+		                                  _mm_maddubs_epi16(v[1], weights)));
+	}
+	return i;
+}
+
+SSSE3 static inline __m128i b64enc_block_ssse3(__m128i in) {
+	__m128i t0, t1, t2, t3, idx, res, less;
+	in = _mm_shuffle_epi8(in, _mm_set_epi8(10,11,9,10, 7,8,6,7, 4,5,3,4, 1,2,0,1));
+	t0 = _mm_and_si128(in, _mm_set1_epi32(0x0fc0fc00));
+	t1 = _mm_mulhi_epu16(t0, _mm_set1_epi32(0x04000040));
+	t2 = _mm_and_si128(in, _mm_set1_epi32(0x003f03f0));
+	t3 = _mm_mullo_epi16(t2, _mm_set1_epi32(0x01000010));
+	idx = _mm_or_si128(t1, t3);
+	res = _mm_subs_epu8(idx, _mm_set1_epi8(51));
+	less = _mm_cmpgt_epi8(_mm_set1_epi8(26), idx);
+	res = _mm_or_si128(res, _mm_and_si128(less, _mm_set1_epi8(13)));
+	res = _mm_shuffle_epi8(_mm_setr_epi8('a'-26, '0'-52, '0'-52, '0'-52, '0'-52,
+	                                     '0'-52, '0'-52, '0'-52, '0'-52, '0'-52,
+	                                     '0'-52, '+'-62, '/'-63, 'A', 0, 0), res);
+	return _mm_add_epi8(res, idx);
+}
+
+SSSE3 static size_t b64enc_ssse3(char *dst, const unsigned char *src, size_t len) {
+	size_t i, o = 0;
+	// 12 bytes are converted, 16 are read
+	for(i=0; i+16 <= len; i+=12, o+=16)
+		_mm_storeu_si128((__m128i*)(dst+o),
+		                 b64enc_block_ssse3(_mm_loadu_si128((const __m128i*)(src+i))));
+	return i;
+}
+
+SSSE3 static size_t b64dec_ssse3(unsigned char *dst, size_t max, const char *src, size_t len) {
+	const __m128i lut_lo = _mm_setr_epi8(0x15, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11,
+	                                     0x11, 0x11, 0x13, 0x1A, 0x1B, 0x1B, 0x1B, 0x1A);
+	const __m128i lut_hi = _mm_setr_epi8(0x10, 0x10, 0x01, 0x02, 0x04, 0x08, 0x04, 0x08,
+	                                     0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10);
+	const __m128i lut_roll = _mm_setr_epi8(0, 16, 19, 4, -65, -65, -71, -71,
+	                                       0, 0, 0, 0, 0, 0, 0, 0);
+	const __m128i mask = _mm_set1_epi8(0x2f);
+	size_t i, o = 0;
+	// 16 chars give 12 bytes, 16 are written
+	for(i=0; i+16 <= len && o+16 <= max; i+=16, o+=12) {
+		__m128i in = _mm_loadu_si128((const __m128i*)(src+i));
+		__m128i hn = _mm_and_si128(_mm_srli_epi32(in, 4), mask);
+		__m128i lo = _mm_shuffle_epi8(lut_lo, _mm_and_si128(in, mask));
+		__m128i hi = _mm_shuffle_epi8(lut_hi, hn);
+		if(_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_and_si128(lo, hi),
+		                                    _mm_setzero_si128())) != 0xFFFF)
+			break;
+		__m128i roll = _mm_shuffle_epi8(lut_roll,
+		                                _mm_add_epi8(_mm_cmpeq_epi8(in, mask), hn));
+		__m128i v = _mm_add_epi8(in, roll);
+		v = _mm_maddubs_epi16(v, _mm_set1_epi32(0x01400140));
+		v = _mm_madd_epi16(v, _mm_set1_epi32(0x00011000));
+		v = _mm_shuffle_epi8(v, _mm_setr_epi8(2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12,
+		                                      -1, -1, -1, -1));
+		_mm_storeu_si128((__m128i*)(dst+o), v);
+	}
+	return i;
+}
+
+// the AVX2 kernels leave the tail to the scalar loop: calling the
+// SSSE3 ones from here would pay the AVX to SSE transition penalty
+AVX2 static size_t hexenc_avx2(char *dst, const unsigned char *src, size_t len) {
+	const __m256i lut = _mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i*)hex_enc));
+	const __m256i mask = _mm256_set1_epi8(0x0f);
+	size_t i;
+	for(i=0; i+32 <= len; i+=32) {
+		__m256i v  = _mm256_loadu_si256((const __m256i*)(src+i));
+		__m256i hi = _mm256_shuffle_epi8(lut, _mm256_and_si256(_mm256_srli_epi16(v, 4), mask));
+		__m256i lo = _mm256_shuffle_epi8(lut, _mm256_and_si256(v, mask));
+		__m256i a  = _mm256_unpacklo_epi8(hi, lo);
+		__m256i b  = _mm256_unpackhi_epi8(hi, lo);
+		_mm256_storeu_si256((__m256i*)(dst+2*i),    _mm256_permute2x128_si256(a, b, 0x20));
+		_mm256_storeu_si256((__m256i*)(dst+2*i+32), _mm256_permute2x128_si256(a, b, 0x31));
+	}
+	return i;
+}
+
+AVX2 static size_t hexdec_avx2(unsigned char *dst, size_t max, const char *src, size_t len) {
+	const __m256i weights = _mm256_set1_epi16(0x0110);
+	size_t i;
+	for(i=0; i+64 <= len && i/2+32 <= max; i+=64) {
+		__m256i c[2], v[2], ok;
+		int k;
+		c[0] = _mm256_loadu_si256((const __m256i*)(src+i));
+		c[1] = _mm256_loadu_si256((const __m256i*)(src+i+32));
+		ok = _mm256_set1_epi8(-1);
+		for(k=0; k<2; k++) {
+			__m256i l  = _mm256_or_si256(c[k], _mm256_set1_epi8(0x20));
+			__m256i md = RANGE256(c[k], '0', '9');
+			__m256i ml = RANGE256(l, 'a', 'f');
+			ok = _mm256_and_si256(ok, _mm256_or_si256(md, ml));
+			v[k] = _mm256_or_si256(
+				_mm256_and_si256(md, _mm256_sub_epi8(c[k], _mm256_set1_epi8('0'))),
+				_mm256_and_si256(ml, _mm256_sub_epi8(l, _mm256_set1_epi8('a'-10))));
+		}
+		if(_mm256_movemask_epi8(ok) != -1) break;
+		__m256i p = _mm256_packus_epi16(_mm256_maddubs_epi16(v[0], weights),
+		                                _mm256_maddubs_epi16(v[1], weights));
+		_mm256_storeu_si256((__m256i*)(dst+i/2), _mm256_permute4x64_epi64(p, 0xD8));
+	}
+	return i;
+}
+
+AVX2 static size_t b64enc_avx2(char *dst, const unsigned char *src, size_t len) {
+	const __m256i shuf = _mm256_broadcastsi128_si256(
+		_mm_set_epi8(10,11,9,10, 7,8,6,7, 4,5,3,4, 1,2,0,1));
+	const __m256i lut = _mm256_broadcastsi128_si256(
+		_mm_setr_epi8('a'-26, '0'-52, '0'-52, '0'-52, '0'-52, '0'-52, '0'-52,
+		              '0'-52, '0'-52, '0'-52, '0'-52, '+'-62, '/'-63, 'A', 0, 0));
+	size_t i, o = 0;
+	// 24 bytes are converted, 28 are read
+	for(i=0; i+28 <= len; i+=24, o+=32) {
+		__m256i in = _mm256_inserti128_si256(
+			_mm256_castsi128_si256(_mm_loadu_si128((const __m128i*)(src+i))),
+			_mm_loadu_si128((const __m128i*)(src+i+12)), 1);
+		__m256i t0, t1, t2, t3, idx, res, less;
+		in = _mm256_shuffle_epi8(in, shuf);
+		t0 = _mm256_and_si256(in, _mm256_set1_epi32(0x0fc0fc00));
+		t1 = _mm256_mulhi_epu16(t0, _mm256_set1_epi32(0x04000040));
+		t2 = _mm256_and_si256(in, _mm256_set1_epi32(0x003f03f0));
+		t3 = _mm256_mullo_epi16(t2, _mm256_set1_epi32(0x01000010));
+		idx = _mm256_or_si256(t1, t3);
+		res = _mm256_subs_epu8(idx, _mm256_set1_epi8(51));
+		less = _mm256_cmpgt_epi8(_mm256_set1_epi8(26), idx);
+		res = _mm256_or_si256(res, _mm256_and_si256(less, _mm256_set1_epi8(13)));
+		res = _mm256_shuffle_epi8(lut, res);
+		_mm256_storeu_si256((__m256i*)(dst+o), _mm256_add_epi8(res, idx));
+	}
+	return i;
+}
+
+AVX2 static size_t b64dec_avx2(unsigned char *dst, size_t max, const char *src, size_t len) {
+	const __m256i lut_lo = _mm256_broadcastsi128_si256(
+		_mm_setr_epi8(0x15, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11,
+		              0x11, 0x11, 0x13, 0x1A, 0x1B, 0x1B, 0x1B, 0x1A));
+	const __m256i lut_hi = _mm256_broadcastsi128_si256(
+		_mm_setr_epi8(0x10, 0x10, 0x01, 0x02, 0x04, 0x08, 0x04, 0x08,
+		              0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10));
+	const __m256i lut_roll = _mm256_broadcastsi128_si256(
+		_mm_setr_epi8(0, 16, 19, 4, -65, -65, -71, -71, 0, 0, 0, 0, 0, 0, 0, 0));
+	const __m256i pack = _mm256_broadcastsi128_si256(
+		_mm_setr_epi8(2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1));
+	const __m256i mask = _mm256_set1_epi8(0x2f);
+	size_t i, o = 0;
+	// 32 chars give 24 bytes, 32 are written
+	for(i=0; i+32 <= len && o+32 <= max; i+=32, o+=24) {
+		__m256i in = _mm256_loadu_si256((const __m256i*)(src+i));
+		__m256i hn = _mm256_and_si256(_mm256_srli_epi32(in, 4), mask);
+		__m256i lo = _mm256_shuffle_epi8(lut_lo, _mm256_and_si256(in, mask));
+		__m256i hi = _mm256_shuffle_epi8(lut_hi, hn);
+		if(_mm256_movemask_epi8(_mm256_cmpeq_epi8(_mm256_and_si256(lo, hi),
+		                                          _mm256_setzero_si256())) != -1)
+			break;
+		__m256i roll = _mm256_shuffle_epi8(lut_roll,
+		                                   _mm256_add_epi8(_mm256_cmpeq_epi8(in, mask), hn));
+		__m256i v = _mm256_add_epi8(in, roll);
+		v = _mm256_maddubs_epi16(v, _mm256_set1_epi32(0x01400140));
+		v = _mm256_madd_epi16(v, _mm256_set1_epi32(0x00011000));
+		v = _mm256_shuffle_epi8(v, pack);
+		v = _mm256_permutevar8x32_epi32(v, _mm256_setr_epi32(0, 1, 2, 4, 5, 6, 7, 7));
+		_mm256_storeu_si256((__m256i*)(dst+o), v);
+	}
+	return i;
+}
+
+static const codec_t codec_ssse3 = {
+	"ssse3", b64enc_ssse3, b64dec_ssse3, hexenc_ssse3, hexdec_ssse3 };
+static const codec_t codec_avx2 = {
+	"avx2", b64enc_avx2, b64dec_avx2, hexenc_avx2, hexdec_avx2 };
+
+#endif // CODEC_X86
+
+static const codec_t *codec = NULL;
+
+// picks the best implementation for this CPU, a race between threads
+// calling it at the same time is harmless
+static void codec_init() {
+	codec = &codec_scalar;
+#ifdef CODEC_X86
+	__builtin_cpu_init();
+	if(__builtin_cpu_supports("avx2")) codec = &codec_avx2;
+	else if(__builtin_cpu_supports("ssse3")) codec = &codec_ssse3;
+#endif
+}
+#define CODEC_INIT() if(!codec) codec_init()
+
+const char *zen_codec_name() {
+	CODEC_INIT();
+	return codec->name;
+}
+
+int zen_codec_select(const char *name) {
+	CODEC_INIT();
+	if(strcmp(name, "scalar")==0) { codec = &codec_scalar; return 1; }
+#ifdef CODEC_X86
+	if(strcmp(name, "ssse3")==0 && __builtin_cpu_supports("ssse3")) {
+		codec = &codec_ssse3; return 1; }
+	if(strcmp(name, "avx2")==0 && __builtin_cpu_supports("avx2")) {
+		codec = &codec_avx2; return 1; }
+#endif
+	return 0;
+}
+
+size_t zen_base64_encode(char *dst, const unsigned char *src, size_t len) {
+	size_t i, o;
+	CODEC_INIT();
+	i = (*codec->b64enc)(dst, src, len);
+	o = i / 3 * 4;
+	for(; i+3 <= len; i+=3) {
+		unsigned int v = (src[i] << 16) | (src[i+1] << 8) | src[i+2];
+		dst[o++] = b64_enc[v >> 18];
+		dst[o++] = b64_enc[(v >> 12) & 63];
+		dst[o++] = b64_enc[(v >> 6) & 63];
+		dst[o++] = b64_enc[v & 63];
+	}
+	if(len - i == 1) {
+		dst[o++] = b64_enc[src[i] >> 2];
+		dst[o++] = b64_enc[(src[i] & 3) << 4];
+		dst[o++] = '=';
+		dst[o++] = '=';
+	} else if(len - i == 2) {
+		dst[o++] = b64_enc[src[i] >> 2];
+		dst[o++] = b64_enc[((src[i] & 3) << 4) | (src[i+1] >> 4)];
+		dst[o++] = b64_enc[(src[i+1] & 15) << 2];
+		dst[o++] = '=';
+	}
+	return o;
+}
+
+long zen_base64_decode(unsigned char *dst, size_t max, const char *src, size_t len) {
+	const unsigned char *s = (const unsigned char*)src;
+	size_t i, o, pad = 0;
+	CODEC_INIT();
+	while(len && s[len-1] == '=' && pad < 2) { len--; pad++; }
+	if(pad && (len + pad) % 4) return ZEN_CODEC_INVALID;
+	if((len & 3) == 1) return ZEN_CODEC_INVALID;
+	i = (*codec->b64dec)(dst, max, src, len);
+	o = i / 4 * 3;
+	for(; i+4 <= len; i+=4) {
+		int a = b64_dec[s[i]], b = b64_dec[s[i+1]];
+		int c = b64_dec[s[i+2]], d = b64_dec[s[i+3]];
+		if((a | b | c | d) < 0) return ZEN_CODEC_INVALID;
+		if(o+3 > max) return ZEN_CODEC_OVERFLOW;
+		dst[o++] = (a << 2) | (b >> 4);
+		dst[o++] = (b << 4) | (c >> 2);
+		dst[o++] = (c << 6) | d;
+	}
+	if(i < len) { // 2 or 3 chars left
+		int a = b64_dec[s[i]], b = b64_dec[s[i+1]];
+		int c = (len - i == 3) ? b64_dec[s[i+2]] : 0;
+		if((a | b | c) < 0) return ZEN_CODEC_INVALID;
+		if(o + len - i - 1 > max) return ZEN_CODEC_OVERFLOW;
+		dst[o++] = (a << 2) | (b >> 4);
+		if(len - i == 3) dst[o++] = (b << 4) | (c >> 2);
+	}
+	return (long)o;
+}
+
+size_t zen_hex_encode(char *dst, const unsigned char *src, size_t len) {
+	size_t i;
+	CODEC_INIT();
+	for(i = (*codec->hexenc)(dst, src, len); i < len; i++) {
+		dst[2*i]   = hex_enc[src[i] >> 4];
+		dst[2*i+1] = hex_enc[src[i] & 15];
+	}
+	return len * 2;
+}
+
+long zen_hex_decode(unsigned char *dst, size_t max, const char *src, size_t len) {
+	const unsigned char *s = (const unsigned char*)src;
+	size_t i;
+	CODEC_INIT();
+	if(len & 1) return ZEN_CODEC_INVALID;
+	for(i = (*codec->hexdec)(dst, max, src, len); i < len; i+=2) {
+		int h = hex_dec[s[i]], l = hex_dec[s[i+1]];
+		if((h | l) < 0) return ZEN_CODEC_INVALID;
+		if(i/2 >= max) return ZEN_CODEC_OVERFLOW;
+		dst[i/2] = (h << 4) | l;
+	}
+	return (long)(len / 2);
+}
@@ -0,0 +1,32 @@
+#ifndef __ZEN_CODEC_H__
+#define __ZEN_CODEC_H__
+
+#include <stddef.h>
+
+// base64 and hex codecs working on whole buffers, validating the
+// input while decoding it. SSSE3 and AVX2 versions are selected at
+// runtime on x86 CPUs supporting them, else a scalar one is used.
+
+// chars needed to encode n bytes in base64 (no NULL terminator)
+#define B64_ENCLEN(n) ((((n)+2)/3)*4)
+// bytes needed to decode n chars of base64 (upper bound)
+#define B64_DECLEN(n) ((((n)+3)/4)*3)
+
+// return the number of chars written
+size_t zen_base64_encode(char *dst, const unsigned char *src, size_t len);
+size_t zen_hex_encode(char *dst, const unsigned char *src, size_t len);
+
+// return the number of bytes written in dst, at most max, or
+// ZEN_CODEC_INVALID when the input is not valid and ZEN_CODEC_OVERFLOW
+// when the decoded bytes do not fit in max
+#define ZEN_CODEC_INVALID  -1
+#define ZEN_CODEC_OVERFLOW -2
+long zen_base64_decode(unsigned char *dst, size_t max, const char *src, size_t len);
+long zen_hex_decode(unsigned char *dst, size_t max, const char *src, size_t len);
+
+// name of the implementation in use: "avx2", "ssse3" or "scalar"
+const char *zen_codec_name();
+// forces an implementation by name, returns 0 if not supported here
+int zen_codec_select(const char *name);
+
+#endif
@@ -0,0 +1,15 @@
+#ifndef __ZEN_CURVES_H__
+#define __ZEN_CURVES_H__
+
+// Helpers for the sources compiled once for each curve: a template
+// header is included after defining ZEN_C as the curve, ZEN_B as its
+// BIG type and ZEN_F as its field, and builds the names it calls with
+// ZEN_CAT, e.g. ZEN_CAT3(ECP_,ZEN_C,_add) for ECP_ED25519_add.
+
+#define ZEN_CAT_(a,b) a##b
+#define ZEN_CAT(a,b) ZEN_CAT_(a,b)
+#define ZEN_CAT3(a,b,c) ZEN_CAT(ZEN_CAT(a,b),c)
+#define ZEN_STR_(a) #a
+#define ZEN_STR(a) ZEN_STR_(a)
+
+#endif
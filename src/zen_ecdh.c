@@ -49,10 +49,11 @@
 #include <lualib.h>
 #include <lauxlib.h>
 
+#include <string.h>
+
 #include <jutils.h>
 #include <zen_error.h>
 #include <zen_octet.h>
-#include <randombytes.h>
 #include <lua_functions.h>
 
 
@@ -63,13 +64,12 @@
 #include <zenroom.h>
 #include <zen_memory.h>
 #include <zen_ecdh.h>
+#include <zen_random.h>
 
 #define KEYPROT(alg,key)	  \
 	error(L, "%s engine has already a %s set:",alg,key); \
 	lerror(L, "Zenroom won't overwrite. Use a .new() instance.");
 
-// from zen_ecdh_factory.h to setup function pointers
-extern ecdh *ecdh_new_curve(lua_State *L, const char *curve);
 
 /// Global ECDH extension
 // @section ecdh.globals
@@ -92,30 +92,22 @@ extern ecdh *ecdh_new_curve(lua_State *L, const char *curve);
 */
 
 ecdh* ecdh_new(lua_State *L, const char *curve) {
-	ecdh *e = ecdh_new_curve(L, curve);
+	const ecdh_curve *c = ecdh_curve_find(curve);
+	if(!c) {
+		error(L, "%s: curve not found: %s",__func__,curve);
+		return NULL; }
+	// the random generator is shared by all keyrings in the context
+	// and taken with zen_random_draw() on each use, seed it now
+	if(!zen_random(L)) return NULL;
+	ecdh *e = (ecdh*)lua_newuserdata(L, sizeof(ecdh));
 	if(!e) { SAFE(e); return NULL; }
+	e->c = c;
 
 	// key storage and key lengths are important 
 	e->seckey = NULL;
-	e->seclen = e->keysize;   // TODO: check for each curve
+	e->seclen = c->keysize;   // TODO: check for each curve
 	e->pubkey = NULL;
-	e->publen = e->keysize*2; // TODO: check for each curve
-
-	// initialise a new random number generator
-	// TODO: make it a newuserdata object in LUA space so that
-	// it can be cleanly collected by the GC as well it can be
-	// saved transparently in the global state
-	e->rng = zen_memory_alloc(sizeof(csprng));
-	char *tmp = zen_memory_alloc(256);
-	randombytes(tmp,252);
-	// using time() from milagro
-	unsign32 ttmp = GET_TIME();
-	tmp[252] = (ttmp >> 24) & 0xff;
-	tmp[253] = (ttmp >> 16) & 0xff;
-	tmp[254] = (ttmp >>  8) & 0xff;
-	tmp[255] =  ttmp & 0xff;	
-	RAND_seed(e->rng,256,tmp);
-	zen_memory_free(tmp);
+	e->publen = c->keysize*2; // TODO: check for each curve
 
 	luaL_getmetatable(L, "zenroom.ecdh");
 	lua_setmetatable(L, -2);
@@ -127,15 +119,6 @@ ecdh* ecdh_arg(lua_State *L,int n) {
 	ecdh *e = (ecdh*)ud;
 	return(e);
 }
-int ecdh_destroy(lua_State *L) {
-	HERE();
-	ecdh *e = ecdh_arg(L,1);
-	SAFE(e);
-	if(e->rng) zen_memory_free(e->rng);
-	// FREE(r->pubkey);
-	// FREE(r->privkey);
-	return 0;
-}
 
 /// Keyring Methods
 // @type keyring
@@ -156,14 +139,15 @@ static int ecdh_keygen(lua_State *L) {
 	HERE();
 	ecdh *e = ecdh_arg(L, 1);	SAFE(e);
 	if(e->seckey) {
-		ERROR(); KEYPROT(e->curve,"private key"); }
+		ERROR(); KEYPROT(e->c->name,"private key"); }
 	if(e->pubkey) {
-		ERROR(); KEYPROT(e->curve,"public key"); }
+		ERROR(); KEYPROT(e->c->name,"public key"); }
 	octet *pk = o_new(L,e->publen); SAFE(pk);
 	octet *sk = o_new(L,e->seclen); SAFE(sk);
-	(*e->ECP__KEY_PAIR_GENERATE)(e->rng,sk,pk);
+	csprng *rng = zen_random_draw(L, e->c->keysize*2); SAFE(rng);
+	(*e->c->ECP__KEY_PAIR_GENERATE)(rng,sk,pk);
 	int res;
-	res = (*e->ECP__PUBLIC_KEY_VALIDATE)(pk);
+	res = (*e->c->ECP__PUBLIC_KEY_VALIDATE)(pk);
 	if(res == ECDH_INVALID_PUBLIC_KEY) {
 		lerror(L, "%s: generated public key is invalid",__func__);
 		lua_pop(L,1); // remove the pk from stack
@@ -195,13 +179,33 @@ static int ecdh_checkpub(lua_State *L) {
 		pk = e->pubkey;
 	} else
 		pk = o_arg(L, 2); SAFE(pk);
-	if((*e->ECP__PUBLIC_KEY_VALIDATE)(pk)==0)
+	if((*e->c->ECP__PUBLIC_KEY_VALIDATE)(pk)==0)
 		lua_pushboolean(L, 1);
 	else
 		lua_pushboolean(L, 0);
 	return 1;
 }
 
+// public key in a keyring or octet at idx, NULL if none
+static octet *session_pubkey(lua_State *L, int idx) {
+	void *ud;
+	octet *pubkey = NULL;
+	// argument is another keyring
+	if((ud = luaL_testudata(L, idx, "zenroom.ecdh"))) {
+		pubkey = ((ecdh*)ud)->pubkey; // take public key from keyring
+		if(pubkey)
+			func(L, "%s: public key found in ecdh keyring (%u bytes)",
+			     __func__, pubkey->len);
+
+		// argument is an octet
+	} else if((ud = luaL_testudata(L, idx, "zenroom.octet"))) {
+		pubkey = (octet*)ud; // take public key from octet
+		func(L, "%s: public key found in octet (%u bytes)",
+		     __func__, pubkey->len);
+	}
+	return pubkey;
+}
+
 /**
    Generate a Diffie-Hellman shared session key. This function takes a
    two keyrings and calculates a shared key to be used in
@@ -217,38 +221,64 @@ static int ecdh_checkpub(lua_State *L) {
 */
 static int ecdh_session(lua_State *L) {
 	HERE();
-	void *ud;
 	octet *pubkey;
-	ecdh *pk;
 	ecdh *e = ecdh_arg(L,1); SAFE(e);
-
-	// argument is another keyring
-	if((ud = luaL_testudata(L, 2, "zenroom.ecdh"))) {
-		pk = (ecdh*)ud;
-		if(!pk->pubkey) {
+	pubkey = session_pubkey(L, 2);
+	if(!pubkey) {
+		if(luaL_testudata(L, 2, "zenroom.ecdh"))
 			lerror(L, "%s: public key not found in keyring",__func__);
-			return 0; }
-		pubkey = pk->pubkey; // take secret key from keyring
-		func(L, "%s: public key found in ecdh keyring (%u bytes)",
-		     __func__, pubkey->len);
-
-		// argument is an octet
-	} else if((ud = luaL_testudata(L, 2, "zenroom.octet"))) {
-		pubkey = (octet*)ud; // take secret key from octet
-		func(L, "%s: public key found in octet (%u bytes)",
-		     __func__, pubkey->len);
-
-	} else {
-		lerror(L, "%s: invalid key in argument",__func__);
+		else
+			lerror(L, "%s: invalid key in argument",__func__);
 		return 0;
 	}
 	int res;
-	res = (*e->ECP__PUBLIC_KEY_VALIDATE)(pubkey);
+	res = (*e->c->ECP__PUBLIC_KEY_VALIDATE)(pubkey);
 	if(res == ECDH_INVALID_PUBLIC_KEY) {
 		lerror(L, "%s: argument found, but is an invalid key",__func__);
 		return 0; }
-	octet *ses = o_new(L,e->keysize); SAFE(ses);
-	(*e->ECP__SVDP_DH)(e->seckey,pubkey,ses);
+	octet *ses = o_new(L,e->c->keysize); SAFE(ses);
+	(*e->c->ECP__SVDP_DH)(e->seckey,pubkey,ses);
+	return 1;
+}
+
+/**
+   Generate the Diffie-Hellman session keys of this keyring's private
+   key with many public keys at once. Takes a table of public keys,
+   as keyrings or octets, and returns a table with the same keys
+   (array positions or names) and the session keys as values: the
+   same as calling <code>keyring:session()</code> on each, but in a
+   single call. Invalid public keys have false as value.
+
+   @param keys table of public keys (keyrings or octets)
+   @function keyring:session_batch(keys)
+   @return a table of session key octets
+*/
+static int ecdh_session_batch(lua_State *L) {
+	HERE();
+	ecdh *e = ecdh_arg(L,1); SAFE(e);
+	luaL_checktype(L, 2, LUA_TTABLE);
+	if(!e->seckey) {
+		lerror(L, "%s: private key not found in keyring",__func__);
+		return 0; }
+	octet *pubkey, *ses;
+	int bad = 0;
+	lua_newtable(L);
+	lua_pushnil(L);
+	while(lua_next(L, 2)) {
+		lua_pushvalue(L, -2); // key of the result
+		pubkey = session_pubkey(L, -2);
+		if(!pubkey
+		   || (*e->c->ECP__PUBLIC_KEY_VALIDATE)(pubkey) == ECDH_INVALID_PUBLIC_KEY) {
+			lua_pushboolean(L, 0);
+			bad++;
+		} else {
+			ses = o_new(L, e->c->keysize); SAFE(ses);
+			(*e->c->ECP__SVDP_DH)(e->seckey,pubkey,ses);
+		}
+		lua_rawset(L, 3);
+		lua_pop(L, 1); // value
+	}
+	if(bad) warning(L, "%s: %i invalid public keys", __func__, bad);
 	return 1;
 }
 
@@ -272,7 +302,7 @@ static int ecdh_public(lua_State *L) {
 			return lerror(L, "Public key is not found in keyring.");
 		}
 		// export public key to octet
-		res = (e->ECP__PUBLIC_KEY_VALIDATE)(e->pubkey);
+		res = (e->c->ECP__PUBLIC_KEY_VALIDATE)(e->pubkey);
 		if(res == ECDH_INVALID_PUBLIC_KEY) {
 			ERROR();
 			return lerror(L, "Public key found, but invalid."); }
@@ -283,9 +313,9 @@ static int ecdh_public(lua_State *L) {
 	// has an argument: public key to set
 	if(e->pubkey!=NULL) {
 		ERROR();
-		KEYPROT(e->curve, "public key"); }
+		KEYPROT(e->c->name, "public key"); }
 	octet *o = o_arg(L, 2); SAFE(o);
-	res = (*e->ECP__PUBLIC_KEY_VALIDATE)(o);
+	res = (*e->c->ECP__PUBLIC_KEY_VALIDATE)(o);
 	if(res == ECDH_INVALID_PUBLIC_KEY) {
 		ERROR();
 		return lerror(L, "Public key argument is invalid."); }
@@ -320,12 +350,12 @@ static int ecdh_private(lua_State *L) {
 		return 1;
 	}
 	if(e->seckey!=NULL) {
-		ERROR(); KEYPROT(e->curve, "private key"); }
+		ERROR(); KEYPROT(e->c->name, "private key"); }
 	e->seckey = o_arg(L, 2); SAFE(e->seckey);
 	octet *pk = o_new(L,e->publen); SAFE(pk);
-	(*e->ECP__KEY_PAIR_GENERATE)(NULL,e->seckey,pk);
+	(*e->c->ECP__KEY_PAIR_GENERATE)(NULL,e->seckey,pk);
 	int res;
-	res = (*e->ECP__PUBLIC_KEY_VALIDATE)(pk);
+	res = (*e->c->ECP__PUBLIC_KEY_VALIDATE)(pk);
 	if(res == ECDH_INVALID_PUBLIC_KEY) {
 		ERROR();
 		return lerror(L, "Invalid public key generation."); }
@@ -349,13 +379,67 @@ static int ecdh_encrypt(lua_State *L) {
 	ecdh *e = ecdh_arg(L, 1);	SAFE(e);
 	octet *k = o_arg(L, 2); SAFE(k);
 	octet *in = o_arg(L, 3); SAFE(in);
-	// output is padded to next word
-	octet *out = o_new(L, in->len+0x0f); SAFE(out);
+	// output is padded to next block, a whole one if already aligned
+	octet *out = o_new(L, in->len+16); SAFE(out);
 	AES_CBC_IV0_ENCRYPT(k,in,out);
 	return 1;
 }
 
 
+/**
+   Encrypt a message to many recipients at once. For each public key
+   in the table, as keyring or octet, the Diffie-Hellman session key
+   with this keyring's private key is used to AES encrypt the message,
+   as <code>keyring:encrypt(keyring:session(key), message)</code>
+   does. Returns a table with the same keys (array positions or names)
+   and the ciphertexts as values, or false for invalid public keys.
+   The session keys are never exposed to Lua.
+
+   @param keys table of public keys (keyrings or octets)
+   @param message input text in an octet
+   @function keyring:encrypt_batch(keys, message)
+   @return a table of ciphertext octets
+   @usage
+   envelopes = keyring:encrypt_batch({ alice = alice_pk, bob = bob_pk }, secret)
+*/
+static int ecdh_encrypt_batch(lua_State *L) {
+	HERE();
+	ecdh *e = ecdh_arg(L,1); SAFE(e);
+	luaL_checktype(L, 2, LUA_TTABLE);
+	octet *in = o_arg(L, 3); SAFE(in);
+	if(!e->seckey) {
+		lerror(L, "%s: private key not found in keyring",__func__);
+		return 0; }
+	// the session key stays in this buffer, wiped at the end
+	char sesbuf[128];
+	octet ses = { 0, sizeof(sesbuf), sesbuf };
+	octet *pubkey, *out;
+	int bad = 0;
+	if(e->c->keysize > (int)sizeof(sesbuf)) {
+		lerror(L, "%s: key size %d not supported",__func__, e->c->keysize);
+		return 0; }
+	lua_newtable(L);
+	lua_pushnil(L);
+	while(lua_next(L, 2)) {
+		lua_pushvalue(L, -2); // key of the result
+		pubkey = session_pubkey(L, -2);
+		if(!pubkey
+		   || (*e->c->ECP__PUBLIC_KEY_VALIDATE)(pubkey) == ECDH_INVALID_PUBLIC_KEY) {
+			lua_pushboolean(L, 0);
+			bad++;
+		} else {
+			(*e->c->ECP__SVDP_DH)(e->seckey,pubkey,&ses);
+			out = o_new(L, in->len+16); SAFE(out);
+			AES_CBC_IV0_ENCRYPT(&ses,in,out);
+		}
+		lua_rawset(L, 4);
+		lua_pop(L, 1); // value
+	}
+	memset(sesbuf, 0, sizeof(sesbuf));
+	if(bad) warning(L, "%s: %i invalid public keys", __func__, bad);
+	return 1;
+}
+
 /**	AES decrypts a plaintext to a ciphtertext.
 
 	IEEE-1363 AES_CBC_IV0_DECRYPT function. Decrypts in CBC mode with
@@ -382,6 +466,145 @@ static int ecdh_decrypt(lua_State *L) {
 	return 1;
 }
 
+/**
+   Sign a message with the private key of the keyring, using ECDSA
+   and the hash function of the keyring. A random ephemeral key is
+   used unless one is given, which should only be done for tests.
+
+   @param message octet of the message to be signed
+   @param k[opt] ephemeral key octet
+   @return a table with r and s octets of the signature
+   @function keyring:sign(message, k)
+   @usage
+   sig = keyring:sign(msg)
+   assert(keyring:verify(msg, sig))
+*/
+static int ecdh_dsa_sign(lua_State *L) {
+	HERE();
+	ecdh *e = ecdh_arg(L, 1);	SAFE(e);
+	octet *msg = o_arg(L, 2); SAFE(msg);
+	octet *k = NULL;
+	if(!lua_isnoneornil(L, 3)) {
+		k = o_arg(L, 3); SAFE(k);
+		if(k->len < e->c->keysize) {
+			lerror(L, "%s: ephemeral key too short (%d bytes)",__func__,k->len);
+			return 0; }
+	}
+	if(!e->seckey) {
+		lerror(L, "%s: private key not found in keyring",__func__);
+		return 0; }
+	lua_createtable(L, 0, 2);
+	octet *r = o_new(L, e->c->keysize); SAFE(r);
+	lua_setfield(L, -2, "r");
+	octet *s = o_new(L, e->c->keysize); SAFE(s);
+	lua_setfield(L, -2, "s");
+	csprng *rng = NULL;
+	if(!k) {
+		rng = zen_random_draw(L, e->c->keysize*2); SAFE(rng); }
+	if((*e->c->ECP__SP_DSA)(e->c->hash, rng, k,
+	                     e->seckey, msg, r, s) != 0) {
+		lerror(L, "%s: signature failed",__func__);
+		return 0; }
+	return 1;
+}
+
+// r and s octets of a signature table at idx, 0 if not found
+static int dsa_signature(lua_State *L, int idx, octet **r, octet **s) {
+	idx = lua_absindex(L, idx);
+	if(lua_type(L, idx) != LUA_TTABLE) return 0;
+	lua_getfield(L, idx, "r");
+	*r = (octet*)luaL_testudata(L, -1, "zenroom.octet");
+	lua_getfield(L, idx, "s");
+	*s = (octet*)luaL_testudata(L, -1, "zenroom.octet");
+	lua_pop(L, 2); // still referenced by the table
+	return (*r && *s);
+}
+
+/**
+   Verify an ECDSA signature of a message made by the private key
+   matching the public key of the keyring.
+
+   @param message octet of the signed message
+   @param signature table with r and s octets as returned by sign()
+   @return true if the signature is valid, false otherwise
+   @function keyring:verify(message, signature)
+*/
+static int ecdh_dsa_verify(lua_State *L) {
+	HERE();
+	ecdh *e = ecdh_arg(L, 1);	SAFE(e);
+	octet *msg = o_arg(L, 2); SAFE(msg);
+	octet *r, *s;
+	if(!dsa_signature(L, 3, &r, &s)) {
+		lerror(L, "%s: invalid signature argument",__func__);
+		return 0; }
+	if(!e->pubkey) {
+		lerror(L, "%s: public key not found in keyring",__func__);
+		return 0; }
+	lua_pushboolean(L,
+	                (*e->c->ECP__VP_DSA)(e->c->hash, e->pubkey, msg, r, s) == 0);
+	return 1;
+}
+
+/**
+   Verify many ECDSA signatures at once, each by its own public key.
+   Takes three arrays of the same length: public keys (keyrings or
+   octets), messages and signatures as returned by sign(). Returns an
+   array of the same length with true for each valid signature and
+   false otherwise, giving the same results of verify(): the modular
+   inversions done for each signature are shared by the whole batch.
+
+   @param keys array of public keys
+   @param messages array of message octets
+   @param signatures array of signature tables
+   @return an array of booleans
+   @function keyring:verify_batch(keys, messages, signatures)
+*/
+static int ecdh_dsa_verify_batch(lua_State *L) {
+	HERE();
+	ecdh *e = ecdh_arg(L, 1);	SAFE(e);
+	luaL_checktype(L, 2, LUA_TTABLE);
+	luaL_checktype(L, 3, LUA_TTABLE);
+	luaL_checktype(L, 4, LUA_TTABLE);
+	int i, n = (int)lua_rawlen(L, 2), good;
+	if((int)lua_rawlen(L, 3) != n || (int)lua_rawlen(L, 4) != n) {
+		lerror(L, "%s: keys, messages and signatures differ in number",__func__);
+		return 0; }
+	lua_createtable(L, n, 0);
+	if(!n) return 1;
+	// all octets stay referenced by the argument tables
+	octet **args = zen_memory_alloc(4 * n * sizeof(octet*));
+	int *res = zen_memory_alloc(n * sizeof(int));
+	if(!args || !res) {
+		if(args) zen_memory_free(args);
+		if(res) zen_memory_free(res);
+		lerror(L, "%s: cannot allocate batch of %d signatures",__func__,n);
+		return 0; }
+	octet **W = args, **M = args + n, **C = args + 2*n, **D = args + 3*n;
+	for(i=0; i<n; i++) {
+		lua_rawgeti(L, 2, i+1);
+		W[i] = session_pubkey(L, -1);
+		lua_rawgeti(L, 3, i+1);
+		M[i] = (octet*)luaL_testudata(L, -1, "zenroom.octet");
+		lua_rawgeti(L, 4, i+1);
+		if(!dsa_signature(L, -1, &C[i], &D[i]))
+			C[i] = D[i] = NULL;
+		lua_pop(L, 3);
+	}
+	good = (*e->c->ECP__VP_DSA_BATCH)(e->c->hash, n, W, M, C, D, res);
+	if(good >= 0)
+		for(i=0; i<n; i++) {
+			lua_pushboolean(L, res[i] == 0);
+			lua_rawseti(L, 5, i+1);
+		}
+	zen_memory_free(args);
+	zen_memory_free(res);
+	if(good < 0) {
+		lerror(L, "%s: cannot allocate batch of %d signatures",__func__,n);
+		return 0; }
+	if(good < n) warning(L, "%s: %i invalid signatures", __func__, n - good);
+	return 1;
+}
+
 /**
    Hash an octet into a new octet. Use the keyring's hash function to
    hash an octet string and return a new one containing the hash of
@@ -396,8 +619,8 @@ static int ecdh_hash(lua_State *L) {
 	ecdh *e = ecdh_arg(L, 1);	SAFE(e);
 	octet *in = o_arg(L, 2); SAFE(in);
 	// hash type indicates also the length in bytes
-	octet *out = o_new(L, e->hash); SAFE(out);
-	HASH(e->hash, in, out);
+	octet *out = o_new(L, e->c->hash); SAFE(out);
+	HASH(e->c->hash, in, out);
 	return 1;
 }
 
@@ -418,9 +641,9 @@ static int ecdh_hmac(lua_State *L) {
 	octet *k = o_arg(L, 2);     SAFE(k);
 	octet *in = o_arg(L, 3);    SAFE(in);	
 	// length defaults to hash bytes
-	const int len = luaL_optinteger(L, 4, e->hash);
+	const int len = luaL_optinteger(L, 4, e->c->hash);
 	octet *out = o_new(L, len); SAFE(out);
-	if(!HMAC(e->hash, in, k, len, out)) {
+	if(!HMAC(e->c->hash, in, k, len, out)) {
 		error(L, "%s: hmac (%u bytes) failed.", len);
 		lua_pop(L, 1);
 		lua_pushboolean(L,0);
@@ -450,7 +673,7 @@ static int ecdh_kdf2(lua_State *L) {
 	// keylen is length of input key
 	const int keylen = luaL_optinteger(L, 4, in->len);
 	octet *out = o_new(L, keylen); SAFE(out);
-	KDF2(e->hash, p, in, keylen, out);
+	KDF2(e->c->hash, p, in, keylen, out);
 	return 1;
 }
 
@@ -481,7 +704,7 @@ static int ecdh_pbkdf2(lua_State *L) {
 	// keylen is length of input key
 	octet *out = o_new(L, keylen); SAFE(out);
 	// default iterations 1000
-	PBKDF2(e->hash, k, s, iter, keylen, out);
+	PBKDF2(e->c->hash, k, s, iter, keylen, out);
 	return 1;
 }
 
@@ -489,7 +712,7 @@ static int lua_new_ecdh(lua_State *L) {
 	const char *curve = luaL_optstring(L, 1, "ed25519");
 	ecdh *e = ecdh_new(L, curve);
 	SAFE(e);
-	func(L,"new ecdh curve %s type %s", e->curve, e->type);
+	func(L,"new ecdh curve %s type %s", e->c->name, e->c->type);
 	// any action to be taken here?
 	return 1;
 }
@@ -500,10 +723,10 @@ static int lua_new_ecdh(lua_State *L) {
 
    Returns a new octet filled with random bytes.
 
-   This method is initialised with a different seed for each keyring
-   upon creation. It doesn't make any difference to use one keyring's
-   RNG or another, but mixing them and making this behavior specific
-   to different scripts helps randomness.
+   All keyrings draw from the same generator, seeded once for the
+   whole execution and reseeded periodically as more keyrings are
+   created: it doesn't make any difference to use one keyring's RNG
+   or another.
 
    Cryptographic security is achieved by hashing the random numbers
    using this sequence: unguessable seed -> SHA -> PRNG internal state
@@ -525,21 +748,488 @@ static int lua_new_ecdh(lua_State *L) {
 static int ecdh_random(lua_State *L) {
 	HERE();
 	ecdh *e = ecdh_arg(L,1); SAFE(e);
-	const int len = luaL_optinteger(L, 2, e->keysize);
+	const int len = luaL_optinteger(L, 2, e->c->keysize);
 	octet *out = o_new(L,len+2); SAFE(out);
-	OCT_rand(out,e->rng,len);
+	csprng *rng = zen_random_draw(L, len); SAFE(rng);
+	OCT_rand(out,rng,len);
+	return 1;
+}
+
+// sources and sinks of the streaming cipher and hashes
+
+// bytes of an octet or string argument
+static const char *stream_data(lua_State *L, int n, size_t *len) {
+	void *ud = luaL_testudata(L, n, "zenroom.octet");
+	if(ud) {
+		*len = ((octet*)ud)->len;
+		return ((octet*)ud)->val; }
+	return luaL_checklstring(L, n, len);
+}
+
+// the file at n, or NULL if it is a function
+static FILE *stream_file(lua_State *L, int n) {
+	luaL_Stream *s = (luaL_Stream*)luaL_testudata(L, n, LUA_FILEHANDLE);
+	if(!s) {
+		luaL_checktype(L, n, LUA_TFUNCTION);
+		return NULL; }
+	if(!s->closef)
+		lerror(L, "%s: attempt to use a closed file", __func__);
+	return s->f;
+}
+
+/// Streaming Cipher
+// @section cipher
+
+/**
+   Start an incremental AES encryption with a key. The cipher returned
+   encrypts data fed in chunks of any size through its
+   <code>:update()</code> and <code>:final()</code> methods, or
+   <code>:pipe()</code> from a source to a sink, using constant
+   memory. The output is the same as <code>keyring:encrypt()</code>
+   on the whole message, which is limited in size.
+
+   @param key AES key octet (16, 24 or 32 bytes)
+   @function keyring:encrypt_stream(key)
+   @return a new cipher
+   @usage
+   enc = keyring:encrypt_stream(key)
+   ct = enc:update(part1) .. enc:update(part2) .. enc:final()
+   assert(ct == keyring:encrypt(key, part1 .. part2))
+*/
+static int cipher_new(lua_State *L, int decrypt) {
+	ecdh *e = ecdh_arg(L, 1);	SAFE(e);
+	octet *k = o_arg(L, 2); SAFE(k);
+	zen_cipher_t *c = (zen_cipher_t*)lua_newuserdata(L, sizeof(zen_cipher_t));
+	memset(c, 0, sizeof(zen_cipher_t));
+	if(!AES_init(&c->aes, CBC, k->len, k->val, NULL)) {
+		lerror(L, "%s: invalid AES key length (%d bytes)", __func__, k->len);
+		return 0; }
+	c->decrypt = decrypt;
+	luaL_getmetatable(L, "zenroom.cipher");
+	lua_setmetatable(L, -2);
+	func(L, "new AES-%u %s stream", k->len*8, decrypt ? "decrypt" : "encrypt");
 	return 1;
 }
+static int ecdh_encrypt_stream(lua_State *L) { return cipher_new(L, 0); }
+
+/**
+   Start an incremental AES decryption with a key, the counterpart of
+   <code>keyring:encrypt_stream()</code>. The last block holds the
+   padding, so it is held back until <code>:final()</code>: only when
+   that succeeds the plain text returned by the updates can be
+   trusted.
+
+   @param key AES key octet
+   @function keyring:decrypt_stream(key)
+   @return a new cipher
+*/
+static int ecdh_decrypt_stream(lua_State *L) { return cipher_new(L, 1); }
+
+static zen_cipher_t *cipher_arg(lua_State *L, int n) {
+	void *ud = luaL_checkudata(L, n, "zenroom.cipher");
+	luaL_argcheck(L, ud != NULL, n, "cipher expected");
+	zen_cipher_t *c = (zen_cipher_t*)ud;
+	if(c->done) {
+		lerror(L, "cipher already finalised");
+		return NULL; }
+	return(c);
+}
+
+static int cipher_destroy(lua_State *L) {
+	zen_cipher_t *c = (zen_cipher_t*)luaL_checkudata(L, 1, "zenroom.cipher");
+	AES_end(&c->aes); // wipes the key schedule
+	return 0;
+}
+
+// bytes update() will output for len bytes of input
+static size_t cipher_outlen(zen_cipher_t *c, size_t len) {
+	size_t total = c->pending + len;
+	if(!c->decrypt) return total & ~(size_t)15;
+	// the last block is kept for final()
+	return total > 16 ? ((total - 1) & ~(size_t)15) : 0;
+}
+
+// processes len bytes into out, which has room for cipher_outlen(),
+// returns the bytes written
+static size_t cipher_update(zen_cipher_t *c, const char *in, size_t len,
+                            char *out) {
+	size_t take, n = 0;
+	if(len) c->fed = 1;
+	while(len) {
+		if(c->decrypt && c->pending == 16) { // more follows: not the last
+			AES_decrypt(&c->aes, c->buf);
+			memcpy(out + n, c->buf, 16);
+			n += 16;
+			c->pending = 0; }
+		take = 16 - c->pending;
+		if(take > len) take = len;
+		memcpy(c->buf + c->pending, in, take);
+		c->pending += take;
+		in += take;
+		len -= take;
+		if(!c->decrypt && c->pending == 16) {
+			AES_encrypt(&c->aes, c->buf);
+			memcpy(out + n, c->buf, 16);
+			n += 16;
+			c->pending = 0; }
+	}
+	return n;
+}
+
+// writes the last block to out (16 bytes), returns its length or -1
+// when the decryption fails
+static int cipher_final(zen_cipher_t *c, char *out) {
+	int i, padlen, res;
+	c->done = 1;
+	if(!c->fed) // empty message, empty output as AES_CBC_IV0_*
+		res = 0;
+	else if(!c->decrypt) {
+		padlen = 16 - c->pending;
+		memset(c->buf + c->pending, padlen, padlen);
+		AES_encrypt(&c->aes, c->buf);
+		memcpy(out, c->buf, 16);
+		res = 16;
+	} else if(c->pending != 16)
+		res = -1; // not a whole number of blocks
+	else {
+		AES_decrypt(&c->aes, c->buf);
+		padlen = (unsigned char)c->buf[15];
+		res = (padlen >= 1 && padlen <= 16) ? 16 - padlen : -1;
+		for(i = 16 - padlen; res >= 0 && i < 16; i++)
+			if(c->buf[i] != padlen) res = -1;
+		if(res > 0) memcpy(out, c->buf, res);
+	}
+	AES_end(&c->aes);
+	memset(c->buf, 0, 16);
+	return res;
+}
+
+/**
+   Process a chunk of data. Input is buffered up to a block and only
+   whole blocks are output, so the octet returned can be shorter than
+   the input or empty.
+
+   @param data octet or string to be processed
+   @function cipher:update(data)
+   @return a new octet with the processed output so far
+*/
+static int cipher_lua_update(lua_State *L) {
+	zen_cipher_t *c = cipher_arg(L, 1); SAFE(c);
+	size_t len;
+	const char *in = stream_data(L, 2, &len);
+	size_t outlen = cipher_outlen(c, len);
+	if(outlen > MAX_FILE) {
+		lerror(L, "%s: chunk too big (%d bytes), use pipe()", __func__, (int)len);
+		return 0; }
+	octet *out = o_new(L, outlen ? outlen : 1); SAFE(out);
+	out->len = cipher_update(c, in, len, out->val);
+	return 1;
+}
+
+/**
+   End the processing: returns the last block, padded when encrypting
+   or with the padding checked and removed when decrypting. The cipher
+   cannot be used anymore afterwards.
+
+   @function cipher:final()
+   @return a new octet with the last output, or false when decryption failed
+*/
+static int cipher_lua_final(lua_State *L) {
+	zen_cipher_t *c = cipher_arg(L, 1); SAFE(c);
+	octet *out = o_new(L, 16); SAFE(out);
+	int res = cipher_final(c, out->val);
+	if(res < 0) {
+		error(L, "%s: decryption failed.", __func__);
+		lua_pop(L, 1);
+		lua_pushboolean(L, 0);
+		return 1; }
+	out->len = res;
+	return 1;
+}
+
+// writes output to the file or passes it to the function at sink
+static void cipher_emit(lua_State *L, int sink, FILE *out,
+                        const char *buf, size_t len) {
+	if(!len) return;
+	if(out) {
+		if(fwrite(buf, 1, len, out) != len)
+			lerror(L, "cipher: error writing to file");
+		return; }
+	lua_pushvalue(L, sink);
+	octet *o = o_new(L, len);
+	memcpy(o->val, buf, len);
+	o->len = len;
+	lua_call(L, 1, 0);
+}
+
+/**
+   Process all data from a source to a sink, then finalise. The source
+   is either an open file, as <code>io.input()</code>, or a function
+   returning octets or strings until nil; the sink is an open file, as
+   <code>io.output()</code>, or a function called with each octet of
+   output. Data is processed in chunks, so its size is not limited by
+   memory.
+
+   @param source file or function providing the input
+   @param sink file or function receiving the output
+   @function cipher:pipe(source, sink)
+   @return total bytes output, or false when decryption failed
+   @usage
+   -- encrypt standard input to standard output
+   keyring:encrypt_stream(key):pipe(io.input(), io.output())
+*/
+static int cipher_lua_pipe(lua_State *L) {
+	zen_cipher_t *c = cipher_arg(L, 1); SAFE(c);
+	char ibuf[STREAM_CHUNK], obuf[STREAM_CHUNK+16];
+	FILE *in = stream_file(L, 2);
+	FILE *out = stream_file(L, 3);
+	const char *data;
+	size_t len, n, total = 0;
+	int res;
+	while(1) {
+		if(in) {
+			len = fread(ibuf, 1, STREAM_CHUNK, in);
+			if(!len) {
+				if(ferror(in))
+					return lerror(L, "%s: error reading from file", __func__);
+				break; }
+			n = cipher_update(c, ibuf, len, obuf);
+			cipher_emit(L, 3, out, obuf, n);
+			total += n;
+			continue; }
+		lua_pushvalue(L, 2);
+		lua_call(L, 0, 1);
+		if(lua_isnil(L, -1)) {
+			lua_pop(L, 1);
+			break; }
+		data = stream_data(L, -1, &len);
+		while(len) { // chunks from functions may be any size
+			size_t take = len > STREAM_CHUNK ? STREAM_CHUNK : len;
+			n = cipher_update(c, data, take, obuf);
+			cipher_emit(L, 3, out, obuf, n);
+			total += n;
+			data += take;
+			len -= take; }
+		lua_pop(L, 1);
+	}
+	res = cipher_final(c, obuf);
+	if(res < 0) {
+		error(L, "%s: decryption failed.", __func__);
+		lua_pushboolean(L, 0);
+		return 1; }
+	cipher_emit(L, 3, out, obuf, res);
+	total += res;
+	lua_pushinteger(L, total);
+	return 1;
+}
+
+/// Streaming Hash
+// @section hash
+
+static void hash_init(zen_hash_t *h) {
+	switch(h->hash) {
+	case SHA256: HASH256_init(&h->sha256); break;
+	case SHA384: HASH384_init(&h->sha512); break;
+	default:     HASH512_init(&h->sha512); break; }
+}
+
+static void hash_process(zen_hash_t *h, const char *in, size_t len) {
+	size_t c;
+	switch(h->hash) {
+	case SHA256: for(c=0; c<len; c++) HASH256_process(&h->sha256, in[c]); break;
+	case SHA384: for(c=0; c<len; c++) HASH384_process(&h->sha512, in[c]); break;
+	default:     for(c=0; c<len; c++) HASH512_process(&h->sha512, in[c]); break; }
+}
+
+static void hash_digest(zen_hash_t *h, char *out) {
+	switch(h->hash) {
+	case SHA256: HASH256_hash(&h->sha256, out); break;
+	case SHA384: HASH384_hash(&h->sha512, out); break;
+	default:     HASH512_hash(&h->sha512, out); break; }
+}
+
+static zen_hash_t *hash_new(lua_State *L, ecdh *e) {
+	zen_hash_t *h = (zen_hash_t*)lua_newuserdata(L, sizeof(zen_hash_t));
+	memset(h, 0, sizeof(zen_hash_t));
+	h->hash = e->c->hash;
+	luaL_getmetatable(L, "zenroom.hash");
+	lua_setmetatable(L, -2);
+	hash_init(h);
+	return h;
+}
+
+/**
+   Start an incremental hash with the keyring's hash function. Data
+   is fed in chunks of any size with <code>:update()</code> or
+   <code>:pipe()</code>, using constant memory, and the digest is
+   returned by <code>:final()</code>: the same as
+   <code>keyring:hash()</code> on the whole data, without the need to
+   concatenate it.
+
+   @function keyring:hash_stream()
+   @return a new hash context
+   @usage
+   h = keyring:hash_stream()
+   for _,part in ipairs(parts) do h:update(part) end
+   digest = h:final()
+*/
+static int ecdh_hash_stream(lua_State *L) {
+	ecdh *e = ecdh_arg(L, 1);	SAFE(e);
+	hash_new(L, e);
+	return 1;
+}
+
+/**
+   Start an incremental HMAC (RFC2104) with a key, the streaming
+   counterpart of <code>keyring:hmac()</code>.
+
+   @param key an octet containing the key to compute the HMAC
+   @param len[opt=keyring->hash bytes] length of the HMAC
+   @function keyring:hmac_stream(key, len)
+   @return a new hash context
+*/
+static int ecdh_hmac_stream(lua_State *L) {
+	ecdh *e = ecdh_arg(L, 1);	SAFE(e);
+	octet *k = o_arg(L, 2);     SAFE(k);
+	const int len = luaL_optinteger(L, 3, e->c->hash);
+	int c, block = e->c->hash > SHA256 ? 128 : 64;
+	if(len < 4 || len > e->c->hash) {
+		lerror(L, "%s: invalid HMAC length %d", __func__, len);
+		return 0; }
+	zen_hash_t *h = hash_new(L, e);
+	h->hmac = len;
+	// K0 is the key padded to a block, or its hash if longer
+	if(k->len > block) {
+		hash_process(h, k->val, k->len);
+		hash_digest(h, h->k0);
+		hash_init(h);
+	} else
+		memcpy(h->k0, k->val, k->len);
+	for(c=0; c<block; c++) h->k0[c] ^= 0x36; // ipad
+	hash_process(h, h->k0, block);
+	return 1;
+}
+
+static zen_hash_t *hash_arg(lua_State *L, int n) {
+	void *ud = luaL_checkudata(L, n, "zenroom.hash");
+	luaL_argcheck(L, ud != NULL, n, "hash expected");
+	zen_hash_t *h = (zen_hash_t*)ud;
+	if(h->done) {
+		lerror(L, "hash already finalised");
+		return NULL; }
+	return(h);
+}
+
+static int hash_destroy(lua_State *L) {
+	zen_hash_t *h = (zen_hash_t*)luaL_checkudata(L, 1, "zenroom.hash");
+	memset(h, 0, sizeof(zen_hash_t)); // wipes the HMAC key
+	return 0;
+}
+
+/**
+   Feed a chunk of data to the hash.
+
+   @param data octet or string
+   @function hash:update(data)
+   @return the hash itself, so that calls can be chained
+*/
+static int hash_lua_update(lua_State *L) {
+	zen_hash_t *h = hash_arg(L, 1); SAFE(h);
+	size_t len;
+	const char *in = stream_data(L, 2, &len);
+	hash_process(h, in, len);
+	lua_settop(L, 1);
+	return 1;
+}
+
+// pushes the digest or HMAC of all data processed
+static int hash_push_final(lua_State *L, zen_hash_t *h) {
+	char digest[64];
+	int c, block = h->hash > SHA256 ? 128 : 64;
+	h->done = 1;
+	hash_digest(h, digest);
+	if(h->hmac) {
+		// outer hash of K0 xor opad and the inner digest
+		for(c=0; c<block; c++) h->k0[c] ^= 0x36 ^ 0x5c;
+		hash_init(h);
+		hash_process(h, h->k0, block);
+		hash_process(h, digest, h->hash);
+		hash_digest(h, digest);
+		memset(h->k0, 0, block);
+	}
+	int len = h->hmac ? h->hmac : h->hash;
+	octet *out = o_new(L, len); SAFE(out);
+	memcpy(out->val, digest, len);
+	out->len = len;
+	return 1;
+}
+
+/**
+   End the hashing and return the digest, or the HMAC. The hash
+   cannot be used anymore afterwards.
+
+   @function hash:final()
+   @return a new octet containing the hash of all data
+*/
+static int hash_lua_final(lua_State *L) {
+	zen_hash_t *h = hash_arg(L, 1); SAFE(h);
+	return hash_push_final(L, h);
+}
+
+/**
+   Hash all data from a source, then finalise. The source is an open
+   file, as <code>io.input()</code>, or a function returning octets
+   or strings until nil.
+
+   @param source file or function providing the data
+   @function hash:pipe(source)
+   @return a new octet containing the hash of all data
+*/
+static int hash_lua_pipe(lua_State *L) {
+	zen_hash_t *h = hash_arg(L, 1); SAFE(h);
+	FILE *in = stream_file(L, 2);
+	char buf[STREAM_CHUNK];
+	const char *data;
+	size_t len;
+	while(1) {
+		if(in) {
+			len = fread(buf, 1, STREAM_CHUNK, in);
+			if(!len) {
+				if(ferror(in))
+					return lerror(L, "%s: error reading from file", __func__);
+				break; }
+			hash_process(h, buf, len);
+			continue; }
+		lua_pushvalue(L, 2);
+		lua_call(L, 0, 1);
+		if(lua_isnil(L, -1)) {
+			lua_pop(L, 1);
+			break; }
+		data = stream_data(L, -1, &len);
+		hash_process(h, data, len);
+		lua_pop(L, 1);
+	}
+	return hash_push_final(L, h);
+}
 
 #define COMMON_METHODS \
 	{"keygen",ecdh_keygen}, \
 	{"session",ecdh_session}, \
+	{"session_batch",ecdh_session_batch}, \
 	{"public", ecdh_public}, \
 	{"private", ecdh_private}, \
 	{"encrypt", ecdh_encrypt}, \
+	{"encrypt_batch", ecdh_encrypt_batch}, \
 	{"decrypt", ecdh_decrypt}, \
+	{"sign", ecdh_dsa_sign}, \
+	{"verify", ecdh_dsa_verify}, \
+	{"verify_batch", ecdh_dsa_verify_batch}, \
+	{"encrypt_stream", ecdh_encrypt_stream}, \
+	{"decrypt_stream", ecdh_decrypt_stream}, \
 	{"hash", ecdh_hash}, \
 	{"hmac", ecdh_hmac}, \
+	{"hash_stream", ecdh_hash_stream}, \
+	{"hmac_stream", ecdh_hmac_stream}, \
 	{"kdf2", ecdh_kdf2}, \
 	{"pbkdf2", ecdh_pbkdf2}, \
 	{"checkpub", ecdh_checkpub}
@@ -552,10 +1242,34 @@ int luaopen_ecdh(lua_State *L) {
 	const struct luaL_Reg ecdh_methods[] = {
 		{"random",ecdh_random},
 		COMMON_METHODS,
-		{"__gc", ecdh_destroy},
 		{NULL,NULL}
 	};
 
+	const struct luaL_Reg cipher_methods[] = {
+		{"update", cipher_lua_update},
+		{"final", cipher_lua_final},
+		{"pipe", cipher_lua_pipe},
+		{"__gc", cipher_destroy},
+		{NULL,NULL}
+	};
+	luaL_newmetatable(L, "zenroom.cipher");
+	lua_pushvalue(L, -1);
+	lua_setfield(L, -2, "__index");
+	luaL_setfuncs(L, cipher_methods, 0);
+	lua_pop(L, 1);
+	const struct luaL_Reg hash_methods[] = {
+		{"update", hash_lua_update},
+		{"final", hash_lua_final},
+		{"pipe", hash_lua_pipe},
+		{"__gc", hash_destroy},
+		{NULL,NULL}
+	};
+	luaL_newmetatable(L, "zenroom.hash");
+	lua_pushvalue(L, -1);
+	lua_setfield(L, -2, "__index");
+	luaL_setfuncs(L, hash_methods, 0);
+	lua_pop(L, 1);
+
 	zen_add_class(L, "ecdh", ecdh_class, ecdh_methods);
 	return 1;
 }
@@ -4,7 +4,14 @@
 #include <zen_octet.h>
 #include <pbc_support.h>
 
+// sizes and operations of a curve, one static table per curve in
+// zen_ecdh_factory.c shared by all keyrings
 typedef struct {
+	const char *name;
+	const char *type;
+	int keysize;
+	int fieldsize;
+	int hash; // hash type is also bytes length of hash
 	// function pointers
 	int (*ECP__KEY_PAIR_GENERATE)(csprng *R,octet *s,octet *W);
 	int (*ECP__PUBLIC_KEY_VALIDATE)(octet *W);
@@ -18,16 +25,42 @@ typedef struct {
 	int (*ECP__SP_DSA)(int h,csprng *R,octet *k,octet *s,
 	                   octet *M,octet *c,octet *d);
 	int (*ECP__VP_DSA)(int h,octet *W,octet *M,octet *c,octet *d);
-	csprng *rng;
-	int keysize;
-	int fieldsize;
-	int hash; // hash type is also bytes length of hash
-	char curve[16]; // just short names
-	char type[16];
+	int (*ECP__VP_DSA_BATCH)(int h,int n,octet **W,octet **M,
+	                         octet **c,octet **d,int *res);
+} ecdh_curve;
+
+// curve by name or alias, NULL if not compiled in
+const ecdh_curve *ecdh_curve_find(const char *name);
+
+typedef struct {
+	const ecdh_curve *c;
 	octet *pubkey;
 	int publen;
 	octet *seckey;
 	int seclen;
 } ecdh;
 
+// incremental AES-CBC with zero IV and PKCS#7 padding, same output as
+// AES_CBC_IV0_ENCRYPT/DECRYPT on the whole message
+#define STREAM_CHUNK 4096 // bytes read at once by pipe()
+
+typedef struct {
+	amcl_aes aes;
+	int decrypt;
+	int fed;     // some input was processed
+	int done;    // final() was called
+	int pending; // bytes in buf
+	char buf[16];
+} zen_cipher_t;
+
+// incremental SHA2 hash or HMAC, same output as HASH() and HMAC()
+typedef struct {
+	int hash; // bytes of the digest: SHA256, SHA384 or SHA512
+	int hmac; // bytes of the HMAC, 0 for a plain hash
+	int done;
+	hash256 sha256;
+	hash512 sha512; // also hash384
+	char k0[128];   // HMAC key padded to a block
+} zen_hash_t;
+
 #endif
@@ -1,3 +1,5 @@
+#include <strings.h>
+
 #include <jutils.h>
 #include <zen_ecdh.h>
 
@@ -7,94 +9,74 @@
 #include <ecdh_BN254CX.h>
 #include <ecdh_FP256BN.h>
 
-ecdh *ecdh_new_curve(lua_State *L, const char *curve) {
-	ecdh *e = NULL;
-	if(strcasecmp(curve,"ec25519")   ==0
-	   || strcasecmp(curve,"ed25519")==0
-	   || strcasecmp(curve,"25519")  ==0) {
-		e = (ecdh*)lua_newuserdata(L, sizeof(ecdh));
-		e->keysize = EGS_ED25519; // keysize seems always equal to
-								  // fieldsize but since milagro uses
-								  // two different defines...
-		e->fieldsize = EFS_ED25519; 
-		e->rng = NULL;
-		e->hash = HASH_TYPE_ECC_ED25519;
-		e->ECP__KEY_PAIR_GENERATE = ECP_ED25519_KEY_PAIR_GENERATE;
-		e->ECP__PUBLIC_KEY_VALIDATE	= ECP_ED25519_PUBLIC_KEY_VALIDATE;
-		e->ECP__SVDP_DH = ECP_ED25519_SVDP_DH;
-		e->ECP__ECIES_ENCRYPT = ECP_ED25519_ECIES_ENCRYPT;
-		e->ECP__ECIES_DECRYPT = ECP_ED25519_ECIES_DECRYPT;
-		e->ECP__SP_DSA = ECP_ED25519_SP_DSA;
-		e->ECP__VP_DSA = ECP_ED25519_VP_DSA;
-		strncpy(e->curve,curve,15);
-#if CURVETYPE_ED25519==MONTGOMERY
-		strcpy(e->type,"montgomery");
-#elif CURVETYPE_ED25519==WEIERSTRASS
-		strcpy(e->type,"weierstrass");
-#elif CURVETYPE_ED25519==EDWARDS
-		strcpy(e->type,"edwards");
+#include <zen_fixed_base.h>
+
+// generator multiples come from precomputed tables unless disabled,
+// then batches of signatures are checked one by one with VP_DSA
+#ifdef ZEN_NO_FIXED_BASE
+#define FIXED_BASE(f) ECP_##f
+#define FIXED_BASE_BATCH(C) NOFB_##C##_VP_DSA_BATCH
+
+#define VP_DSA_LOOP(C) \
+	static int NOFB_##C##_VP_DSA_BATCH(int h, int n, octet **W, octet **M, \
+	                                   octet **c, octet **d, int *res) { \
+		int i, good = 0; \
+		for(i=0; i<n; i++) { \
+			res[i] = (W[i] && M[i] && c[i] && d[i]) ? \
+				ECP_##C##_VP_DSA(h, W[i], M[i], c[i], d[i]) : ECDH_INVALID; \
+			if(res[i] == ECDH_OK) good++; } \
+		return good; }
+
+VP_DSA_LOOP(ED25519)
+VP_DSA_LOOP(NIST256)
+VP_DSA_LOOP(GOLDILOCKS)
+VP_DSA_LOOP(BN254CX)
+VP_DSA_LOOP(FP256BN)
 #else
-		strcpy(e->type,"unknown");
+#define FIXED_BASE(f) FB_##f
+#define FIXED_BASE_BATCH(C) FB_##C##_VP_DSA_BATCH
 #endif
-	} else if(strcasecmp(curve,"nist256")==0) {
-			e = (ecdh*)lua_newuserdata(L, sizeof(ecdh));
-			e->keysize = EGS_NIST256;
-			e->fieldsize = EFS_NIST256;
-			e->rng = NULL;
-			e->hash = HASH_TYPE_ECC_NIST256;
-			e->ECP__KEY_PAIR_GENERATE = ECP_NIST256_KEY_PAIR_GENERATE;
-			e->ECP__PUBLIC_KEY_VALIDATE	= ECP_NIST256_PUBLIC_KEY_VALIDATE;
-			e->ECP__SVDP_DH = ECP_NIST256_SVDP_DH;
-			e->ECP__ECIES_ENCRYPT = ECP_NIST256_ECIES_ENCRYPT;
-			e->ECP__ECIES_DECRYPT = ECP_NIST256_ECIES_DECRYPT;
-			e->ECP__SP_DSA = ECP_NIST256_SP_DSA;
-			e->ECP__VP_DSA = ECP_NIST256_VP_DSA;
 
-	} else if(strcasecmp(curve,"goldilocks")==0) {
-		e = (ecdh*)lua_newuserdata(L, sizeof(ecdh));
-		e->keysize = EGS_GOLDILOCKS;
-		e->fieldsize = EFS_GOLDILOCKS;
-		e->rng = NULL;
-		e->hash = HASH_TYPE_ECC_GOLDILOCKS;
-		e->ECP__KEY_PAIR_GENERATE = ECP_GOLDILOCKS_KEY_PAIR_GENERATE;
-		e->ECP__PUBLIC_KEY_VALIDATE	= ECP_GOLDILOCKS_PUBLIC_KEY_VALIDATE;
-		e->ECP__SVDP_DH = ECP_GOLDILOCKS_SVDP_DH;
-		e->ECP__ECIES_ENCRYPT = ECP_GOLDILOCKS_ECIES_ENCRYPT;
-		e->ECP__ECIES_DECRYPT = ECP_GOLDILOCKS_ECIES_DECRYPT;
-		e->ECP__SP_DSA = ECP_GOLDILOCKS_SP_DSA;
-		e->ECP__VP_DSA = ECP_GOLDILOCKS_VP_DSA;
+#define ECDH_TYPE(t) ((t)==EDWARDS ? "edwards" :	  \
+                      (t)==WEIERSTRASS ? "weierstrass" : "montgomery")
+
+// keysize seems always equal to fieldsize but since milagro uses two
+// different defines...
+#define ECDH_CURVE(C,name) {	  \
+		name, ECDH_TYPE(CURVETYPE_##C), EGS_##C, EFS_##C, \
+		HASH_TYPE_ECC_##C, \
+		FIXED_BASE(C##_KEY_PAIR_GENERATE), \
+		ECP_##C##_PUBLIC_KEY_VALIDATE, \
+		ECP_##C##_SVDP_DH, \
+		ECP_##C##_ECIES_ENCRYPT, \
+		ECP_##C##_ECIES_DECRYPT, \
+		FIXED_BASE(C##_SP_DSA), \
+		ECP_##C##_VP_DSA, \
+		FIXED_BASE_BATCH(C) }
 
-	} else if(strcasecmp(curve,"bn254cx")==0) {
-		e = (ecdh*)lua_newuserdata(L, sizeof(ecdh));
-		e->keysize = EGS_BN254CX;
-		e->fieldsize = EFS_BN254CX;
-		e->rng = NULL;
-		e->hash = HASH_TYPE_ECC_BN254CX;
-		e->ECP__KEY_PAIR_GENERATE = ECP_BN254CX_KEY_PAIR_GENERATE;
-		e->ECP__PUBLIC_KEY_VALIDATE	= ECP_BN254CX_PUBLIC_KEY_VALIDATE;
-		e->ECP__SVDP_DH = ECP_BN254CX_SVDP_DH;
-		e->ECP__ECIES_ENCRYPT = ECP_BN254CX_ECIES_ENCRYPT;
-		e->ECP__ECIES_DECRYPT = ECP_BN254CX_ECIES_DECRYPT;
-		e->ECP__SP_DSA = ECP_BN254CX_SP_DSA;
-		e->ECP__VP_DSA = ECP_BN254CX_VP_DSA;
+static const ecdh_curve ecdh_ed25519    = ECDH_CURVE(ED25519,    "ed25519");
+static const ecdh_curve ecdh_nist256    = ECDH_CURVE(NIST256,    "nist256");
+static const ecdh_curve ecdh_goldilocks = ECDH_CURVE(GOLDILOCKS, "goldilocks");
+static const ecdh_curve ecdh_bn254cx    = ECDH_CURVE(BN254CX,    "bn254cx");
+static const ecdh_curve ecdh_fp256bn    = ECDH_CURVE(FP256BN,    "fp256bn");
 
-	} else if(strcasecmp(curve,"fp256bn")==0) {
-		e = (ecdh*)lua_newuserdata(L, sizeof(ecdh));
-		e->keysize = EGS_FP256BN;
-		e->fieldsize = EFS_FP256BN;
-		e->rng = NULL;
-		e->hash = HASH_TYPE_ECC_FP256BN;
-		e->ECP__KEY_PAIR_GENERATE = ECP_FP256BN_KEY_PAIR_GENERATE;
-		e->ECP__PUBLIC_KEY_VALIDATE	= ECP_FP256BN_PUBLIC_KEY_VALIDATE;
-		e->ECP__SVDP_DH = ECP_FP256BN_SVDP_DH;
-		e->ECP__ECIES_ENCRYPT = ECP_FP256BN_ECIES_ENCRYPT;
-		e->ECP__ECIES_DECRYPT = ECP_FP256BN_ECIES_DECRYPT;
-		e->ECP__SP_DSA = ECP_FP256BN_SP_DSA;
-		e->ECP__VP_DSA = ECP_FP256BN_VP_DSA;
+static const struct {
+	const char *name;
+	const ecdh_curve *curve;
+} ecdh_names[] = {
+	{ "ed25519",    &ecdh_ed25519 },
+	{ "ec25519",    &ecdh_ed25519 },
+	{ "25519",      &ecdh_ed25519 },
+	{ "nist256",    &ecdh_nist256 },
+	{ "goldilocks", &ecdh_goldilocks },
+	{ "bn254cx",    &ecdh_bn254cx },
+	{ "fp256bn",    &ecdh_fp256bn },
+	{ NULL, NULL } };
 
-	} else {
-		error(L, "%s: curve not found: %s",__func__,curve);
-		return NULL;
-	}
-	return e;
+const ecdh_curve *ecdh_curve_find(const char *name) {
+	int c;
+	for(c=0; ecdh_names[c].name; c++)
+		if(strcasecmp(name, ecdh_names[c].name)==0)
+			return ecdh_names[c].curve;
+	return NULL;
 }
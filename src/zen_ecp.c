@@ -16,7 +16,8 @@
 // License along with this program.  If not, see
 // <http://www.gnu.org/licenses/>.
 
-// For now, the only supported curve is ED25519 type EDWARDS
+// Supported curves are those compiled in for ECDH: ED25519,
+// NIST256, GOLDILOCKS, BN254CX and FP256BN (see zen_ecp_factory.c)
 
 
 /// <h1>Elliptic Curve Point Arithmetic (ECP)</h1>
@@ -32,7 +33,8 @@
 //
 //  After requiring the extension it is possible to create ECP points
 //  instances using the new() method, taking two arguments (the x and
-//  y coordinates):
+//  y coordinates) optionally preceded by the name of the curve, which
+//  is ED25519 when not specified:
 //
 //  <code>
 // ecpsum = ecp.new(
@@ -47,7 +49,8 @@
 //
 //  Once ECP numbers are created this way, the arithmetic operations
 //  of addition, subtraction and multiplication can be executed
-//  normally using overloaded operators (+ - *).
+//  normally using overloaded operators (+ - *). Operations between
+//  points need both to be on the same curve.
 //
 //  @module ecp
 //  @author Denis "Jaromil" Roio
@@ -59,71 +62,26 @@
 #include <lualib.h>
 #include <lauxlib.h>
 
-#include <ecp_ED25519.h>
-
 #include <jutils.h>
 #include <zen_error.h>
+#include <zen_memory.h>
 #include <zen_octet.h>
 #include <zen_ecp.h>
 #include <lua_functions.h>
 
-void oct2big(BIG_256_29 b, const octet *o) {
-	BIG_256_29_zero(b);
-	BIG_256_29_fromBytesLen(b,o->val,o->len);
-}
-void int2big(BIG_256_29 b, int n) {
-	BIG_256_29_zero(b);
-	BIG_256_29_inc(b, n);
-	BIG_256_29_norm(b);
-}
-char *big2strhex(char *str, BIG_256_29 a) {
-	BIG_256_29 b;
-	int i,len;
-	int modby2 = MODBYTES_256_29<<1;
-	len=BIG_256_29_nbits(a);
-	int lendiv4 = len>>2;
-	if (len%4==0) len=lendiv4;
-	else {
-		len=lendiv4;
-		len++;
-	}
-	if (len<modby2) len=modby2;
-	int c = 0;
-	for (i=len-1; i>=0; i--) {
-		BIG_256_29_copy(b,a);
-		BIG_256_29_shr(b,i<<2);
-		sprintf(str+c,"%01x",(unsigned int) b[0]&15);
-		c++;
-	}
-	return str;
-}
-
-/***
-    Create a new ECP point from two x,y octet arguments.
-
-    Supported curve: ed25519
+#define ECP_DEFAULT_CURVE "ed25519"
 
-    @param X octet of a big number
-    @param Y octet of a big number
-    @return a new ECP point on the curve at X,Y coordinates
-    @function new(X,Y)
-*/
-ecp* ecp_new(lua_State *L) {
-	ecp *e = (ecp *)lua_newuserdata(L, sizeof(ecp));
+// the point lives in the same userdata, right after the struct
+ecp* ecp_new(lua_State *L, const ecp_curve *c) {
+	ecp *e = (ecp *)lua_newuserdata(L, sizeof(ecp) + c->size);
 	if(!e) {
 		lerror(L, "Error allocating new ecp in %s",__func__);
 		return NULL; }
-	e->ed25519 = malloc(sizeof(ECP_ED25519));
-	strcpy(e->curve,"ed25519");
-#if CURVETYPE_ED25519==MONTGOMERY
-	strcpy(e->type,"montgomery");
-#elif CURVETYPE_ED25519==WEIERSTRASS
-	strcpy(e->type,"weierstrass");
-#elif CURVETYPE_ED25519==EDWARDS
-	strcpy(e->type,"edwards");
-#else
-	strcpy(e->type,"unknown");
-#endif
+	e->c = c;
+	e->P = (void*)(e+1);
+	e->normal = 0;
+	strncpy(e->curve, c->name, 15); e->curve[15] = '\0';
+	strncpy(e->type,  c->type, 15); e->type[15] = '\0';
 	luaL_getmetatable(L, "zenroom.ecp");
 	lua_setmetatable(L, -2);
 	return(e);
@@ -135,33 +93,46 @@ ecp* ecp_arg(lua_State *L,int n) {
 	return(e);
 }
 ecp* ecp_dup(lua_State *L, const ecp* in) {
-	ecp *e = ecp_new(L); SAFE(e);
-	ECP_ED25519_copy(e->ed25519, in->ed25519);
+	ecp *e = ecp_new(L, in->c); SAFE(e);
+	e->c->copy(e->P, in->P);
+	e->normal = in->normal;
 	return(e);
 }
+// to affine coordinates unless already there, so that a point pays
+// for at most one inversion however many times it is printed
+static void ecp_normal(ecp *e) {
+	if(e->normal) return;
+	e->c->affine(e->P);
+	e->normal = !e->c->isinf(e->P);
+}
+// second point argument of a binary operation, on the curve of e
+static ecp* ecp_arg_same(lua_State *L, int n, const ecp *e) {
+	ecp *q = ecp_arg(L, n); SAFE(q);
+	if(q->c != e->c) {
+		lerror(L, "%s: points are on different curves (%s and %s)",
+		       __func__, e->curve, q->curve);
+		return NULL; }
+	return q;
+}
+// curve named by the string at idx, or the default one
+static const ecp_curve *curve_arg(lua_State *L, int idx) {
+	const char *name = ECP_DEFAULT_CURVE;
+	const ecp_curve *c;
+	if(lua_type(L, idx) == LUA_TSTRING)
+		name = lua_tostring(L, idx);
+	c = ecp_curve_find(name);
+	if(!c) lerror(L, "%s: curve not supported: %s", __func__, name);
+	return c;
+}
 ecp* ecp_set_big_xy(lua_State *L, ecp *e, int idx) {
 	SAFE(e);
-	octet *o;
-	o = o_arg(L, idx); SAFE(o);
-	BIG_256_29 x;
-	oct2big(x, o);
-#if CURVETYPE_ED25519==MONTGOMERY
-	ECP_ED25519_set(e->ed25519, x);
-#else
-	o = o_arg(L, idx+1); SAFE(o);
-	BIG_256_29 y;
-	oct2big(y, o);
-	ECP_ED25519_set(e->ed25519, x, y);
-#endif
+	octet *x, *y;
+	x = o_arg(L, idx); SAFE(x);
+	y = o_arg(L, idx+1); SAFE(y);
+	// an invalid point is set to infinity, with z = 0 on weierstrass
+	e->normal = e->c->set(e->P, x, y);
 	return e;
 }
-int ecp_destroy(lua_State *L) {
-	HERE();
-	ecp *e = ecp_arg(L,1);
-	SAFE(e);
-	FREE(e->ed25519);
-	return 0;
-}
 /***
     Set an existing ECP point with two new x,y octet arguments.
 
@@ -177,12 +148,43 @@ static int lua_set_ecp(lua_State *L) {
 	return 0;
 }
 
+/***
+    Create a new ECP point from two x,y octet arguments. Without
+    coordinates the new point is the infinity of the curve.
+
+    Supported curves: ed25519 (default), nist256, goldilocks, bn254cx, fp256bn
+
+    @param curve[opt=ed25519] name of the curve
+    @param X octet of a big number
+    @param Y octet of a big number
+    @return a new ECP point on the curve at X,Y coordinates
+    @function new([curve,] X,Y)
+*/
 static int lua_new_ecp(lua_State *L) {
-	ecp *e = ecp_new(L); SAFE(e);
+	int idx = 1;
+	const ecp_curve *c = curve_arg(L, 1); SAFE(c);
+	if(lua_type(L, 1) == LUA_TSTRING) idx++;
+	ecp *e = ecp_new(L, c); SAFE(e);
 	func(L,"new ecp curve %s type %s", e->curve, e->type);
-	void *x = luaL_testudata(L, 1, "zenroom.octet");
-	void *y = luaL_testudata(L, 2, "zenroom.octet");
-	if(x && y) e = ecp_set_big_xy(L, e, 1);
+	void *x = luaL_testudata(L, idx, "zenroom.octet");
+	void *y = luaL_testudata(L, idx+1, "zenroom.octet");
+	if(x && y) e = ecp_set_big_xy(L, e, idx);
+	else c->inf(e->P);
+	return 1;
+}
+
+/***
+    Create a new ECP point at the generator of a curve.
+
+    @param curve[opt=ed25519] name of the curve
+    @return a new ECP point at the generator
+    @function generator([curve])
+*/
+static int lua_generator_ecp(lua_State *L) {
+	const ecp_curve *c = curve_arg(L, 1); SAFE(c);
+	ecp *e = ecp_new(L, c); SAFE(e);
+	c->generator(e->P);
+	e->normal = 1;
 	return 1;
 }
 
@@ -192,7 +194,7 @@ static int lua_new_ecp(lua_State *L) {
 */
 static int ecp_affine(lua_State *L) {
 	ecp *e = ecp_arg(L,1); SAFE(e);
-	ECP_ED25519_affine(e->ed25519);
+	ecp_normal(e);
 	return 0;
 }
 
@@ -204,24 +206,28 @@ static int ecp_affine(lua_State *L) {
 */
 static int ecp_isinf(lua_State *L) {
 	const ecp *e = ecp_arg(L,1); SAFE(e);
-	lua_pushboolean(L,ECP_ED25519_isinf(e->ed25519));
+	lua_pushboolean(L,e->c->isinf(e->P));
 	return 1;
 }
 
 /***
     Map a BIG number to a point of the curve, the BIG number should be the output of some hash function.
 
+    @param curve[opt=ed25519] name of the curve
     @param big octet of a BIG number (single number holding coordinates)
-    @function mapit(big)
+    @function mapit([curve,] big)
 */
 static int ecp_mapit(lua_State *L) {
-	octet *o = o_arg(L,1); SAFE(o);
-	if(o->len < MODBYTES_256_29) {
-		lerror(L, "%s: octet too short (min %u bytes)",
-		       __func__, MODBYTES_256_29);
+	int idx = 1;
+	const ecp_curve *c = curve_arg(L, 1); SAFE(c);
+	if(lua_type(L, 1) == LUA_TSTRING) idx++;
+	octet *o = o_arg(L,idx); SAFE(o);
+	if(o->len < c->modbytes) {
+		lerror(L, "%s: octet too short (min %d bytes)",
+		       __func__, c->modbytes);
 		return 0; }
-	const ecp *e = ecp_new(L); SAFE(e);
-	ECP_ED25519_mapit(e->ed25519, o);
+	const ecp *e = ecp_new(L, c); SAFE(e);
+	c->mapit(e->P, o);
 	return 1;
 }
 
@@ -235,10 +241,11 @@ static int ecp_mapit(lua_State *L) {
 */
 static int ecp_add(lua_State *L) {
 	const ecp *e = ecp_arg(L,1); SAFE(e);
-	const ecp *q = ecp_arg(L,2); SAFE(q);
+	const ecp *q = ecp_arg_same(L,2,e); SAFE(q);
 	ecp *p = ecp_dup(L, e); // push
 	SAFE(p);
-	ECP_ED25519_add(p->ed25519,q->ed25519);
+	p->c->add(p->P,q->P);
+	p->normal = 0;
 	return 1;
 }
 
@@ -252,10 +259,11 @@ static int ecp_add(lua_State *L) {
 */
 static int ecp_sub(lua_State *L) {
 	const ecp *e = ecp_arg(L,1); SAFE(e);
-	const ecp *q = ecp_arg(L,2); SAFE(q);
+	const ecp *q = ecp_arg_same(L,2,e); SAFE(q);
 	ecp *p = ecp_dup(L, e); // push
 	SAFE(p);
-	ECP_ED25519_sub(p->ed25519,q->ed25519);
+	p->c->sub(p->P,q->P);
+	p->normal = 0;
 	return 1;
 }
 
@@ -267,7 +275,7 @@ static int ecp_sub(lua_State *L) {
 static int ecp_negative(lua_State *L) {
 	const ecp *in = ecp_arg(L,1); SAFE(in);
 	const ecp *out = ecp_dup(L,in); SAFE(out);
-	ECP_ED25519_neg(out->ed25519);
+	out->c->neg(out->P); // z is the same
 	return 1;
 }
 
@@ -278,11 +286,35 @@ static int ecp_negative(lua_State *L) {
 */
 static int ecp_double(lua_State *L) {
 	const ecp *in = ecp_arg(L,1); SAFE(in);
-	const ecp *out = ecp_dup(L,in); SAFE(out);
-	ECP_ED25519_dbl(out->ed25519);
+	ecp *out = ecp_dup(L,in); SAFE(out);
+	out->c->dbl(out->P);
+	out->normal = 0;
 	return 1;
 }
 
+// scalar from a number or octet argument, 0 if neither: numbers are
+// written as 4 big endian bytes in the octet given, octets are
+// returned as they are
+static octet *scalar_arg(lua_State *L, int idx, octet *num) {
+	void *ud;
+	if(lua_isnumber(L, idx)) {
+		lua_Number n = lua_tonumber(L, idx);
+		unsigned int v;
+		if(n < 0 || n > 0xffffffff) {
+			lerror(L, "%s: number out of range: %f", __func__, n);
+			return NULL; }
+		v = (unsigned int)n;
+		num->val[0] = (v >> 24) & 0xff;
+		num->val[1] = (v >> 16) & 0xff;
+		num->val[2] = (v >>  8) & 0xff;
+		num->val[3] =  v        & 0xff;
+		num->len = 4;
+		return num; }
+	if((ud = luaL_testudata(L, idx, "zenroom.octet")))
+		return (octet*)ud;
+	return NULL;
+}
+
 /***
     Multiply an ECP point a number of times, indicated by an arbitrary ordinal number. Can be made using the overloaded operator "*" between an ECP object and an integer number.
 
@@ -293,19 +325,137 @@ static int ecp_double(lua_State *L) {
     @return new ecp point resulting from the multiplication
 */
 static int ecp_mul(lua_State *L) {
-	BIG_256_29 big;
-	void *ud;
+	char buf[4];
+	octet num = { 0, 4, buf }, *k;
 	ecp *e = ecp_arg(L,1); SAFE(e);
-	if(lua_isnumber(L,2)) {
-		lua_Number num = lua_tonumber(L,2);
-		int2big(big, (int)num);
-	} else if((ud = luaL_testudata(L, 2, "zenroom.octet"))) {
-		octet *o = (octet*)ud; SAFE(o);
-		oct2big(big,o);
+	k = scalar_arg(L, 2, &num);
+	if(!k) {
+		lerror(L, "%s: number or octet expected", __func__);
+		return 0; }
+	ecp *out = ecp_dup(L,e); SAFE(out);
+	out->c->mul(out->P,k);
+	out->normal = 0;
+	return 1;
+}
+
+/***
+    Multi-scalar multiplication: sum of the products of points and
+    numbers taken in order from two arrays of the same length, much
+    faster than multiplying and adding each point on its own,
+    especially for long arrays. All points must be on the same curve.
+
+    @function msm(points, numbers)
+    @param points array of ECP points
+    @param numbers array of numbers or octets of big numbers
+    @return new ecp point resulting from the sum of products
+    @usage
+    -- same as P1 * k1 + P2 * k2 + P3 * k3
+    sum = ecp.msm({ P1, P2, P3 }, { k1, k2, k3 })
+*/
+static int ecp_msm(lua_State *L) {
+	int i, n;
+	ecp *e;
+	const ecp_curve *c = NULL;
+	luaL_checktype(L, 1, LUA_TTABLE);
+	luaL_checktype(L, 2, LUA_TTABLE);
+	n = (int)lua_rawlen(L, 1);
+	if(!n || (int)lua_rawlen(L, 2) != n) {
+		lerror(L, "%s: points and numbers must be non-empty arrays of the same length",__func__);
+		return 0; }
+	lua_rawgeti(L, 1, 1);
+	e = (ecp*)luaL_testudata(L, -1, "zenroom.ecp");
+	if(e) c = e->c;
+	lua_pop(L, 1);
+	if(!c) {
+		lerror(L, "%s: invalid term 1",__func__);
+		return 0; }
+	// points are copied in a contiguous array, numbers are octets
+	// pointing to the arguments or to 4 bytes in nums
+	char *P = zen_memory_alloc(n * c->size);
+	octet *k = zen_memory_alloc(n * sizeof(octet));
+	char *nums = zen_memory_alloc(n * 4);
+	if(!P || !k || !nums) {
+		if(P) zen_memory_free(P);
+		if(k) zen_memory_free(k);
+		if(nums) zen_memory_free(nums);
+		lerror(L, "%s: cannot allocate %d terms",__func__,n);
+		return 0; }
+	for(i=0; i<n; i++) {
+		octet num = { 0, 4, nums + i*4 }, *o = NULL;
+		lua_rawgeti(L, 1, i+1);
+		e = (ecp*)luaL_testudata(L, -1, "zenroom.ecp");
+		if(e && e->c == c) c->copy(P + i*c->size, e->P);
+		lua_rawgeti(L, 2, i+1);
+		if(e && e->c == c) o = scalar_arg(L, -1, &num);
+		if(!o) {
+			zen_memory_free(P); zen_memory_free(k); zen_memory_free(nums);
+			lerror(L, "%s: invalid term %d",__func__,i+1);
+			return 0; }
+		k[i] = *o;
+		lua_pop(L, 2);
 	}
-	// TODO: check parsing errors
-	const ecp *out = ecp_dup(L,e); SAFE(out);
-	ECP_ED25519_mul(out->ed25519,big);
+	const ecp *out = ecp_new(L, c); SAFE(out);
+	i = c->msm(out->P, P, k, n);
+	zen_memory_free(P);
+	zen_memory_free(k);
+	zen_memory_free(nums);
+	if(!i) {
+		lerror(L, "%s: cannot allocate tables for %d terms",__func__,n);
+		return 0; }
+	return 1;
+}
+
+/***
+    Convert many ECP points to affine coordinates at once, with a
+    single field inversion instead of one per point. The points are
+    changed in place and stay the same points of the curve: this only
+    saves time later, when their coordinates are printed or exported
+    with octet(). All points must be on the same curve.
+
+    @function normalise(points)
+    @param points array of ECP points
+    @return number of points converted
+*/
+static int ecp_normalise(lua_State *L) {
+	int i, n, cnt = 0;
+	ecp *e, **E;
+	void **P;
+	const ecp_curve *c = NULL;
+	luaL_checktype(L, 1, LUA_TTABLE);
+	n = (int)lua_rawlen(L, 1);
+	if(!n) {
+		lua_pushinteger(L, 0);
+		return 1; }
+	E = zen_memory_alloc(n * sizeof(ecp*));
+	P = zen_memory_alloc(n * sizeof(void*));
+	if(!E || !P) {
+		if(E) zen_memory_free(E);
+		if(P) zen_memory_free(P);
+		lerror(L, "%s: cannot allocate %d points",__func__,n);
+		return 0; }
+	for(i=0; i<n; i++) {
+		lua_rawgeti(L, 1, i+1);
+		e = (ecp*)luaL_testudata(L, -1, "zenroom.ecp");
+		lua_pop(L, 1); // still referenced by the table
+		if(e && !c) c = e->c;
+		if(!e || e->c != c) {
+			zen_memory_free(E); zen_memory_free(P);
+			lerror(L, "%s: invalid point %d",__func__,i+1);
+			return 0; }
+		if(e->normal) continue;
+		E[cnt] = e;
+		P[cnt] = e->P;
+		cnt++;
+	}
+	if(cnt && !c->normalise(P, cnt)) {
+		zen_memory_free(E); zen_memory_free(P);
+		lerror(L, "%s: cannot allocate %d points",__func__,cnt);
+		return 0; }
+	for(i=0; i<cnt; i++)
+		E[i]->normal = !c->isinf(E[i]->P);
+	zen_memory_free(E);
+	zen_memory_free(P);
+	lua_pushinteger(L, cnt);
 	return 1;
 }
 
@@ -320,11 +470,10 @@ static int ecp_mul(lua_State *L) {
 static int ecp_eq(lua_State *L) {
 	const ecp *p = ecp_arg(L,1); SAFE(p);
 	const ecp *q = ecp_arg(L,2); SAFE(q);
-// TODO: is affine rly needed?
-	ECP_ED25519_affine(p->ed25519);
-	ECP_ED25519_affine(q->ed25519);
-	lua_pushboolean(L,ECP_ED25519_equals(
-		                p->ed25519, q->ed25519));
+	if(p->c != q->c) { // points of different curves are never equal
+		lua_pushboolean(L, 0);
+		return 1; }
+	lua_pushboolean(L, p->c->equals(p->P, q->P));
 	return 1;
 }
 
@@ -339,52 +488,44 @@ static int ecp_octet(lua_State *L) {
 	ecp *e = ecp_arg(L,1); SAFE(e);
 	if((ud = luaL_testudata(L, 2, "zenroom.octet"))) {
 		octet *o = (octet*)ud; SAFE(o);
-		if(! ECP_ED25519_fromOctet(e->ed25519, o) )
+		e->normal = e->c->fromOctet(e->P, o);
+		if(! e->normal )
 			lerror(L,"Octet doesn't contains a valid ECP");
 		return 0;
 	}
-	octet *o = o_new(L,(MODBYTES_256_29<<1)+1);
+	ecp_normal(e);
+	octet *o = o_new(L,(e->c->modbytes<<1)+1);
 	SAFE(o);
-	ECP_ED25519_toOctet(o, e->ed25519);
+	e->c->toOctet(o, e->P);
 	return 1;
 }
 
+#define ECP_OUTPUT \
+"{ \"curve\": \"%s\",\n" \
+"  \"type\": \"%s\",\n" \
+"  \"encoding\": \"hex\",\n" \
+"  \"vm\": \"%s\",\n" \
+"  \"x\": \"%s\",\n" \
+"  \"y\": \"%s\" }"
+
 static int ecp_output(lua_State *L) {
-	const ecp *e = ecp_arg(L, 1); SAFE(e);
-	ECP_ED25519 *P = e->ed25519;
-	if (ECP_ED25519_isinf(P)) {
+	ecp *e = ecp_arg(L, 1); SAFE(e);
+	if (e->c->isinf(e->P)) {
 		lua_pushstring(L,"Infinity");
 		return 1; }
-	BIG_256_29 x;
-	char xs[256];
-	char out[512];
-	ECP_ED25519_affine(P);
-#if CURVETYPE_ED25519==MONTGOMERY
-	FP_25519_redc(x,&(P->x));
-	snprintf(out,511,
-	         "{ \"curve\": \"%s\",\n"
-	         "  \"type\": \"%s\",\n"
-	         "  \"encoding\": \"hex\",\n"
-	         "  \"vm\": \"%s\",\n"
-	         "  \"x\": \"%s\" }",
-	         e->curve, e->type, VERSION,
-	         big2strhex(xs,x));
-#else
-	BIG_256_29 y;
-	char ys[256];
-	FP_25519_redc(x,&(P->x));
-	FP_25519_redc(y,&(P->y));
-	snprintf(out, 511,
-"{ \"curve\": \"%s\",\n"
-"  \"type\": \"%s\",\n"
-"  \"encoding\": \"hex\",\n"
-"  \"vm\": \"%s\",\n"
-"  \"x\": \"%s\",\n"
-"  \"y\": \"%s\" }",
-	         e->curve, e->type, VERSION,
-	         big2strhex(xs,x), big2strhex(ys,y));
-#endif
-	lua_pushstring(L,out);
+	char xs[2*ECP_MAX_MODBYTES+1];
+	char ys[2*ECP_MAX_MODBYTES+1];
+	char out[sizeof(ECP_OUTPUT) + sizeof(e->curve) + sizeof(e->type)
+	         + sizeof(VERSION) + sizeof(xs) + sizeof(ys)];
+	int len;
+	ecp_normal(e);
+	e->c->coords(e->P, xs, ys);
+	len = snprintf(out, sizeof(out), ECP_OUTPUT,
+	               e->curve, e->type, VERSION, xs, ys);
+	if(len < 0 || (size_t)len >= sizeof(out)) {
+		lerror(L, "%s: point does not fit in the output", __func__);
+		return 0; }
+	lua_pushlstring(L, out, len);
 	return 1;
 }
 
@@ -392,13 +533,16 @@ int luaopen_ecp(lua_State *L) {
 	const struct luaL_Reg ecp_class[] = {
 		{"new",lua_new_ecp},
 		{"set",lua_set_ecp},
+		{"generator",lua_generator_ecp},
+		{"mapit",ecp_mapit},
+		{"msm",ecp_msm},
+		{"normalise",ecp_normalise},
 		{NULL,NULL}};
 	const struct luaL_Reg ecp_methods[] = {
 		{"affine",ecp_affine},
 		{"negative",ecp_negative},
 		{"double",ecp_double},
 		{"isinf",ecp_isinf},
-		{"mapit",ecp_mapit},
 		{"octet",ecp_octet},
 		{"add",ecp_add},
 		{"__add",ecp_add},
@@ -408,7 +552,6 @@ int luaopen_ecp(lua_State *L) {
 		{"__mul",ecp_mul},
         {"eq",ecp_eq},
 		{"__eq", ecp_eq},
-		{"__gc",ecp_destroy},
 		{"__tostring",ecp_output},
 		{NULL,NULL}
 	};
@@ -1,11 +1,48 @@
+#ifndef __ZEN_ECP_H__
+#define __ZEN_ECP_H__
 
-#include <ecp_ED25519.h>
+#include <zen_octet.h>
+
+// bytes of the largest field compiled in (goldilocks), bounds the
+// hex coordinates written by coords()
+#define ECP_MAX_MODBYTES 56
+
+// point operations of one curve, ECP_<curve>_* functions of Milagro
+// taking points as void* and numbers as octets of big endian bytes
+typedef struct {
+	const char *name;
+	const char *type;
+	int modbytes;
+	size_t size; // of a point
+	int  (*set)(void *P, octet *x, octet *y);
+	void (*generator)(void *P);
+	void (*copy)(void *P, void *Q);
+	void (*inf)(void *P);
+	int  (*isinf)(void *P);
+	void (*affine)(void *P);
+	void (*add)(void *P, void *Q);
+	void (*sub)(void *P, void *Q);
+	void (*neg)(void *P);
+	void (*dbl)(void *P);
+	void (*mul)(void *P, octet *k);
+	int  (*msm)(void *R, void *P, octet *k, int n);
+	int  (*equals)(void *P, void *Q); // projective, no inversion
+	int  (*normalise)(void **P, int n); // affine with one inversion
+	void (*mapit)(void *P, octet *o);
+	void (*toOctet)(octet *o, void *P);
+	int  (*fromOctet)(void *P, octet *o);
+	void (*coords)(void *P, char *x, char *y); // hex, 2*modbytes+1 each
+} ecp_curve;
+
+// curve by name as in ecdh.new(), NULL if not compiled in
+const ecp_curve *ecp_curve_find(const char *name);
 
 typedef struct {
 	char curve[16];
 	char type[16];
-	ECP_ED25519 *ed25519;
+	const ecp_curve *c;
+	int normal; // known to be affine (z = 1)
+	void *P; // ECP_<curve> allocated after this struct
 } ecp;
 
-
-
+#endif
@@ -0,0 +1,247 @@
+// Point operations of the ecp module for one curve, included by
+// zen_ecp_factory.c once per curve with ZEN_C, ZEN_B and ZEN_F set as
+// described in zen_curves.h and ZEN_NAME to the name used in Lua.
+
+#define EC_BIG       ZEN_CAT(BIG_,ZEN_B)
+#define EC_BIGF(f)   ZEN_CAT3(BIG_,ZEN_B,_##f)
+#define EC_FP        ZEN_CAT(FP_,ZEN_F)
+#define EC_FPF(f)    ZEN_CAT3(FP_,ZEN_F,_##f)
+#define EC_ECP       ZEN_CAT(ECP_,ZEN_C)
+#define EC_ECPF(f)   ZEN_CAT3(ECP_,ZEN_C,_##f)
+#define EC_(f)       ZEN_CAT3(ec_,ZEN_C,_##f)
+#define EC_MODBYTES  ZEN_CAT(MODBYTES_,ZEN_B)
+#define EC_CURVETYPE ZEN_CAT(CURVETYPE_,ZEN_C)
+
+#if EC_CURVETYPE==EDWARDS
+#define EC_TYPE "edwards"
+#elif EC_CURVETYPE==WEIERSTRASS
+#define EC_TYPE "weierstrass"
+#else
+#error "ecp: montgomery curves are not supported"
+#endif
+
+#if EC_MODBYTES > ECP_MAX_MODBYTES
+#error "ecp: field too big, raise ECP_MAX_MODBYTES in zen_ecp.h"
+#endif
+
+static void EC_(big)(EC_BIG b, octet *o) {
+	EC_BIGF(zero)(b);
+	EC_BIGF(fromBytesLen)(b, o->val, o->len);
+}
+
+static int EC_(set)(void *P, octet *x, octet *y) {
+	EC_BIG bx, by;
+	EC_(big)(bx, x);
+	EC_(big)(by, y);
+	return EC_ECPF(set)((EC_ECP*)P, bx, by);
+}
+
+static void EC_(generator)(void *P) {
+	EC_BIG x, y;
+	EC_BIGF(rcopy)(x, ZEN_CAT(CURVE_Gx_,ZEN_C));
+	EC_BIGF(rcopy)(y, ZEN_CAT(CURVE_Gy_,ZEN_C));
+	EC_ECPF(set)((EC_ECP*)P, x, y);
+}
+
+static void EC_(copy)(void *P, void *Q) { EC_ECPF(copy)((EC_ECP*)P, (EC_ECP*)Q); }
+static void EC_(inf)(void *P)           { EC_ECPF(inf)((EC_ECP*)P); }
+static int  EC_(isinf)(void *P)         { return EC_ECPF(isinf)((EC_ECP*)P); }
+static void EC_(affine)(void *P)        { EC_ECPF(affine)((EC_ECP*)P); }
+static void EC_(add)(void *P, void *Q)  { EC_ECPF(add)((EC_ECP*)P, (EC_ECP*)Q); }
+static void EC_(sub)(void *P, void *Q)  { EC_ECPF(sub)((EC_ECP*)P, (EC_ECP*)Q); }
+static void EC_(neg)(void *P)           { EC_ECPF(neg)((EC_ECP*)P); }
+static void EC_(dbl)(void *P)           { EC_ECPF(dbl)((EC_ECP*)P); }
+static void EC_(mapit)(void *P, octet *o) { EC_ECPF(mapit)((EC_ECP*)P, o); }
+static void EC_(toOctet)(octet *o, void *P) { EC_ECPF(toOctet)(o, (EC_ECP*)P); }
+static int  EC_(fromOctet)(void *P, octet *o) { return EC_ECPF(fromOctet)((EC_ECP*)P, o); }
+
+// x1/z1 == x2/z2 and y1/z1 == y2/z2 compared as x1*z2 == x2*z1 and
+// y1*z2 == y2*z1, no inversion and the points are left as they are;
+// also right for the infinity (0,1,0) of weierstrass curves
+static int EC_(equals)(void *P, void *Q) {
+	EC_ECP *p = (EC_ECP*)P, *q = (EC_ECP*)Q;
+	EC_FP a, b;
+	EC_FPF(mul)(&a, &p->x, &q->z);
+	EC_FPF(mul)(&b, &q->x, &p->z);
+	if(!EC_FPF(equals)(&a, &b)) return 0;
+	EC_FPF(mul)(&a, &p->y, &q->z);
+	EC_FPF(mul)(&b, &q->y, &p->z);
+	return EC_FPF(equals)(&a, &b);
+}
+
+// affine coordinates for all points with one field inversion:
+// 1/z[i] = (z[0]...z[i-1]) / (z[0]...z[i]). The infinity of
+// weierstrass curves (z = 0) is left as it is.
+static int EC_(normalise)(void **P, int n) {
+	EC_FP *pre = zen_memory_alloc(n * sizeof(EC_FP));
+	EC_FP acc, inv;
+	EC_ECP *p;
+	int i;
+	if(!pre) return 0;
+	EC_FPF(one)(&acc);
+	for(i=0; i<n; i++) {
+		p = (EC_ECP*)P[i];
+		if(EC_ECPF(isinf)(p)) continue;
+		EC_FPF(copy)(&pre[i], &acc);
+		EC_FPF(mul)(&acc, &acc, &p->z);
+	}
+	EC_FPF(inv)(&inv, &acc);
+	for(i=n-1; i>=0; i--) {
+		p = (EC_ECP*)P[i];
+		if(EC_ECPF(isinf)(p)) continue;
+		EC_FPF(mul)(&pre[i], &pre[i], &inv);
+		EC_FPF(mul)(&inv, &inv, &p->z);
+		EC_FPF(mul)(&p->x, &p->x, &pre[i]);
+		EC_FPF(mul)(&p->y, &p->y, &pre[i]);
+		EC_FPF(reduce)(&p->x);
+		EC_FPF(reduce)(&p->y);
+		EC_FPF(one)(&p->z);
+	}
+	zen_memory_free(pre);
+	return 1;
+}
+
+static void EC_(mul)(void *P, octet *k) {
+	EC_BIG b;
+	EC_(big)(b, k);
+	EC_ECPF(mul)((EC_ECP*)P, b);
+}
+
+static void EC_(hex)(char *s, EC_BIG b) {
+	char bytes[EC_MODBYTES];
+	int i;
+	EC_BIGF(toBytes)(bytes, b);
+	for(i=0; i<EC_MODBYTES; i++)
+		sprintf(s+2*i, "%02x", (unsigned char)bytes[i]);
+}
+
+static void EC_(coords)(void *P, char *x, char *y) {
+	EC_BIG bx, by;
+	EC_ECPF(get)(bx, by, (EC_ECP*)P);
+	EC_(hex)(x, bx);
+	EC_(hex)(y, by);
+}
+
+// c bits of k from pos, bits past the length of all scalars are 0
+static int EC_(digit)(EC_BIG k, int pos, int c, int bits) {
+	int j, d = 0;
+	for(j=c-1; j>=0; j--) {
+		d <<= 1;
+		if(pos+j < bits) d |= EC_BIGF(bit)(k, pos+j);
+	}
+	return d;
+}
+
+static int EC_(straus)(EC_ECP *R, EC_ECP *P, EC_BIG *k, int n, int bits) {
+	const int tlen = (1<<MSM_STRAUS_BITS) - 1;
+	EC_ECP *T = zen_memory_alloc(n * tlen * sizeof(EC_ECP));
+	int i, j, d, pos, top;
+	if(!T) return 0;
+	for(i=0; i<n; i++) { // T[i*tlen + j] = (j+1) * P[i]
+		EC_ECPF(copy)(&T[i*tlen], &P[i]);
+		for(j=1; j<tlen; j++) {
+			EC_ECPF(copy)(&T[i*tlen+j], &T[i*tlen+j-1]);
+			EC_ECPF(add)(&T[i*tlen+j], &P[i]);
+		}
+	}
+	top = ((bits + MSM_STRAUS_BITS - 1) / MSM_STRAUS_BITS) * MSM_STRAUS_BITS;
+	EC_ECPF(inf)(R);
+	for(pos = top - MSM_STRAUS_BITS; pos >= 0; pos -= MSM_STRAUS_BITS) {
+		if(pos < top - MSM_STRAUS_BITS)
+			for(j=0; j<MSM_STRAUS_BITS; j++) EC_ECPF(dbl)(R);
+		for(i=0; i<n; i++) {
+			d = EC_(digit)(k[i], pos, MSM_STRAUS_BITS, bits);
+			if(d) EC_ECPF(add)(R, &T[i*tlen+d-1]);
+		}
+	}
+	zen_memory_free(T);
+	return 1;
+}
+
+static int EC_(pippenger)(EC_ECP *R, EC_ECP *P, EC_BIG *k, int n, int bits, int c) {
+	const int nb = (1<<c) - 1; // digit 0 has no bucket
+	EC_ECP *B = zen_memory_alloc(nb * sizeof(EC_ECP));
+	char *used = zen_memory_alloc(nb);
+	EC_ECP S, W;
+	int i, j, d, pos, top, sum, wsum;
+	if(!B || !used) {
+		if(B) zen_memory_free(B);
+		if(used) zen_memory_free(used);
+		return 0; }
+	top = ((bits + c - 1) / c) * c;
+	EC_ECPF(inf)(R);
+	for(pos = top - c; pos >= 0; pos -= c) {
+		if(pos < top - c)
+			for(j=0; j<c; j++) EC_ECPF(dbl)(R);
+		memset(used, 0, nb);
+		for(i=0; i<n; i++) {
+			d = EC_(digit)(k[i], pos, c, bits);
+			if(!d) continue;
+			if(used[d-1]) EC_ECPF(add)(&B[d-1], &P[i]);
+			else {
+				EC_ECPF(copy)(&B[d-1], &P[i]);
+				used[d-1] = 1; }
+		}
+		// W = sum of (j+1) * B[j]: S runs over the buckets from the top
+		// and is added to W at each step
+		sum = wsum = 0;
+		for(j=nb-1; j>=0; j--) {
+			if(used[j]) {
+				if(sum) EC_ECPF(add)(&S, &B[j]);
+				else { EC_ECPF(copy)(&S, &B[j]); sum = 1; }
+			}
+			if(sum) {
+				if(wsum) EC_ECPF(add)(&W, &S);
+				else { EC_ECPF(copy)(&W, &S); wsum = 1; }
+			}
+		}
+		if(wsum) EC_ECPF(add)(R, &W);
+	}
+	zen_memory_free(B);
+	zen_memory_free(used);
+	return 1;
+}
+
+static int EC_(msm)(void *R, void *P, octet *k, int n) {
+	EC_BIG *b = zen_memory_alloc(n * sizeof(EC_BIG));
+	int i, c, bits = 0, res;
+	if(!b) return 0;
+	for(i=0; i<n; i++) {
+		EC_(big)(b[i], &k[i]);
+		c = EC_BIGF(nbits)(b[i]);
+		if(c > bits) bits = c; }
+	if(!bits) {
+		EC_ECPF(inf)((EC_ECP*)R);
+		zen_memory_free(b);
+		return 1; }
+	c = msm_window(n, bits);
+	func(NULL, "%s: %d terms of %d bits on %s, %s window %d", __func__,
+	     n, bits, ZEN_NAME, c ? "pippenger" : "straus",
+	     c ? c : MSM_STRAUS_BITS);
+	res = c ? EC_(pippenger)((EC_ECP*)R, (EC_ECP*)P, b, n, bits, c)
+		: EC_(straus)((EC_ECP*)R, (EC_ECP*)P, b, n, bits);
+	zen_memory_free(b);
+	return res;
+}
+
+static const ecp_curve EC_(curve) = {
+	ZEN_NAME, EC_TYPE, EC_MODBYTES, sizeof(EC_ECP),
+	EC_(set), EC_(generator), EC_(copy), EC_(inf), EC_(isinf),
+	EC_(affine), EC_(add), EC_(sub), EC_(neg), EC_(dbl), EC_(mul),
+	EC_(msm), EC_(equals), EC_(normalise), EC_(mapit), EC_(toOctet), EC_(fromOctet),
+	EC_(coords) };
+
+#undef EC_BIG
+#undef EC_BIGF
+#undef EC_FP
+#undef EC_FPF
+#undef EC_ECP
+#undef EC_ECPF
+#undef EC_
+#undef EC_MODBYTES
+#undef EC_CURVETYPE
+#undef EC_TYPE
+#undef ZEN_C
+#undef ZEN_B
+#undef ZEN_F
+#undef ZEN_NAME
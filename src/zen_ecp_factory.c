@@ -0,0 +1,115 @@
+/*  Zenroom (DECODE project)
+ *
+ *  (c) Copyright 2017-2018 Dyne.org foundation
+ *  designed, written and maintained by Denis Roio <jaromil@dyne.org>
+ *
+ * This source code is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Public License as published
+ * by the Free Software Foundation; either version 3 of the License,
+ * or (at your option) any later version.
+ *
+ * This source code is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * Please refer to the GNU Public License for more details.
+ *
+ * You should have received a copy of the GNU Public License along with
+ * this source code; if not, write to:
+ * Free Software Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+
+
+// Point operations of the ecp module for each curve compiled in, the
+// same found by ecdh.new(). An ecp object resolves its curve once at
+// creation, all operations then go straight through its table.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+
+#include <jutils.h>
+#include <zen_memory.h>
+#include <zen_curves.h>
+#include <zen_ecp.h>
+
+#include <ecp_ED25519.h>
+#include <ecp_NIST256.h>
+#include <ecp_GOLDILOCKS.h>
+#include <ecp_BN254CX.h>
+#include <ecp_FP256BN.h>
+
+// Multi-scalar multiplication R = k[0]*P[0] + ... + k[n-1]*P[n-1].
+//
+// Few terms use Straus' method: each point gets a table of its first
+// 15 multiples and one chain of doublings is shared by all, adding a
+// table entry for each point every 4 bits. Many terms use Pippenger's
+// buckets: for each window of c bits, every point is added to the
+// bucket of its digit and the buckets are weighted with a running
+// sum, so the cost per window grows with n + 2^c instead of n * 2^c.
+// The method (and c) with less additions is chosen. Scalars are
+// considered public, both run in variable time.
+#define MSM_STRAUS_BITS 4
+#define MSM_MAX_BUCKET_BITS 10
+
+// bucket window for Pippenger, 0 if Straus needs less additions (the
+// doublings are about the same)
+static int msm_window(int n, int bits) {
+	int c, best = 0;
+	long cost, min;
+	min = (long)n * ((1<<MSM_STRAUS_BITS) - 2)
+		+ (long)n * ((bits + MSM_STRAUS_BITS - 1) / MSM_STRAUS_BITS);
+	for(c=2; c<=MSM_MAX_BUCKET_BITS; c++) {
+		cost = (long)((bits + c - 1) / c) * (n + 2 * ((1<<c) - 1));
+		if(cost < min) {
+			min = cost;
+			best = c; }
+	}
+	return best;
+}
+
+#define ZEN_C ED25519
+#define ZEN_B 256_29
+#define ZEN_F 25519
+#define ZEN_NAME "ed25519"
+#include "zen_ecp_curve.h"
+
+#define ZEN_C NIST256
+#define ZEN_B 256_28
+#define ZEN_F NIST256
+#define ZEN_NAME "nist256"
+#include "zen_ecp_curve.h"
+
+#define ZEN_C GOLDILOCKS
+#define ZEN_B 448_29
+#define ZEN_F GOLDILOCKS
+#define ZEN_NAME "goldilocks"
+#include "zen_ecp_curve.h"
+
+#define ZEN_C BN254CX
+#define ZEN_B 256_28
+#define ZEN_F BN254CX
+#define ZEN_NAME "bn254cx"
+#include "zen_ecp_curve.h"
+
+#define ZEN_C FP256BN
+#define ZEN_B 256_28
+#define ZEN_F FP256BN
+#define ZEN_NAME "fp256bn"
+#include "zen_ecp_curve.h"
+
+const ecp_curve *ecp_curve_find(const char *name) {
+	if(strcasecmp(name,"ec25519")   ==0
+	   || strcasecmp(name,"ed25519")==0
+	   || strcasecmp(name,"25519")  ==0)
+		return &ec_ED25519_curve;
+	if(strcasecmp(name,"nist256")==0)
+		return &ec_NIST256_curve;
+	if(strcasecmp(name,"goldilocks")==0)
+		return &ec_GOLDILOCKS_curve;
+	if(strcasecmp(name,"bn254cx")==0)
+		return &ec_BN254CX_curve;
+	if(strcasecmp(name,"fp256bn")==0)
+		return &ec_FP256BN_curve;
+	return NULL;
+}
@@ -0,0 +1,96 @@
+/*  Zenroom (DECODE project)
+ *
+ *  (c) Copyright 2017-2018 Dyne.org foundation
+ *  designed, written and maintained by Denis Roio <jaromil@dyne.org>
+ *
+ * This source code is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Public License as published
+ * by the Free Software Foundation; either version 3 of the License,
+ * or (at your option) any later version.
+ *
+ * This source code is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * Please refer to the GNU Public License for more details.
+ *
+ * You should have received a copy of the GNU Public License along with
+ * this source code; if not, write to:
+ * Free Software Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+
+
+// Fixed base scalar multiplication for key generation and signing.
+//
+// Both multiply the curve generator G by a secret scalar, which the
+// generic ECP_mul does with a double and add ladder, about 256
+// doublings and 64 additions for a 256 bit curve. Since G never
+// changes, each curve has a table of the multiples j * 16^i * G (j
+// from 1 to 8) for all the 4 bit windows of a scalar. Written in
+// signed digits from -8 to 7, a scalar needs one point from each row
+// and the multiplication becomes one addition per window and no
+// doublings at all.
+//
+// Batch verification of ECDSA signatures also takes the G term of
+// each check from the tables, and shares the two inversions (of the
+// signature scalar modulo the order and of the Z coordinate of the
+// resulting point) among all signatures of the batch.
+//
+// Tables are built the first time a curve is used and shared
+// read-only by all contexts and threads of the process. Lookups scan
+// the whole row and negate with masks, so the time taken does not
+// depend on the value of the scalar.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if !defined(__EMSCRIPTEN__)
+#include <pthread.h>
+#endif
+
+#include <jutils.h>
+#include <zen_memory.h>
+#include <zen_curves.h>
+#include <zen_fixed_base.h>
+
+#define FB_ENTRIES 8 // multiples in each row of a table
+
+// 1 if a == b, else 0
+static inline int fb_equal(int a, int b) {
+	return (int)(((unsigned)(a ^ b) - 1) >> (sizeof(int)*8-1));
+}
+
+// copies len bytes of src over dst if d is 1, leaves dst if d is 0
+static inline void fb_cmove(void *dst, const void *src, size_t len, int d) {
+	unsigned char *p = (unsigned char*)dst;
+	const unsigned char *q = (const unsigned char*)src;
+	unsigned char mask = (unsigned char)-d;
+	size_t c;
+	for(c=0; c<len; c++)
+		p[c] ^= mask & (p[c] ^ q[c]);
+}
+
+#define ZEN_C ED25519
+#define ZEN_B 256_29
+#define ZEN_F 25519
+#include "zen_fixed_base_curve.h"
+
+#define ZEN_C NIST256
+#define ZEN_B 256_28
+#define ZEN_F NIST256
+#include "zen_fixed_base_curve.h"
+
+#define ZEN_C GOLDILOCKS
+#define ZEN_B 448_29
+#define ZEN_F GOLDILOCKS
+#include "zen_fixed_base_curve.h"
+
+#define ZEN_C BN254CX
+#define ZEN_B 256_28
+#define ZEN_F BN254CX
+#include "zen_fixed_base_curve.h"
+
+#define ZEN_C FP256BN
+#define ZEN_B 256_28
+#define ZEN_F FP256BN
+#include "zen_fixed_base_curve.h"
@@ -0,0 +1,30 @@
+#ifndef __ZEN_FIXED_BASE_H__
+#define __ZEN_FIXED_BASE_H__
+
+#include <ecdh_ED25519.h>
+#include <ecdh_NIST256.h>
+#include <ecdh_GOLDILOCKS.h>
+#include <ecdh_BN254CX.h>
+#include <ecdh_FP256BN.h>
+
+// Multiplication of the curve generator with a table of its multiples
+// computed once per process (see zen_fixed_base.c). The FB_ functions
+// are drop-in replacements of the ECP_ ones of the same name, with the
+// same arguments and results. FB_<curve>_VP_DSA_BATCH runs VP_DSA on
+// arrays of n signatures, writing its results in res.
+
+#define FIXED_BASE_PROTOTYPES(C,B)	  \
+	void FB_##C##_mul(ECP_##C *P, BIG_##B e); \
+	int FB_##C##_KEY_PAIR_GENERATE(csprng *R, octet *s, octet *W); \
+	int FB_##C##_SP_DSA(int h, csprng *R, octet *k, octet *s, \
+	                    octet *M, octet *c, octet *d); \
+	int FB_##C##_VP_DSA_BATCH(int h, int n, octet **W, octet **M, \
+	                          octet **c, octet **d, int *res);
+
+FIXED_BASE_PROTOTYPES(ED25519,256_29)
+FIXED_BASE_PROTOTYPES(NIST256,256_28)
+FIXED_BASE_PROTOTYPES(GOLDILOCKS,448_29)
+FIXED_BASE_PROTOTYPES(BN254CX,256_28)
+FIXED_BASE_PROTOTYPES(FP256BN,256_28)
+
+#endif
@@ -0,0 +1,311 @@
+// Fixed base multiplication for one curve, included by zen_fixed_base.c
+// once per curve with ZEN_C set to the curve name, ZEN_B to its BIG
+// type and ZEN_F to its field, as in ECP_<ZEN_C>_mul,
+// BIG_<ZEN_B>_copy and FP_<ZEN_F>_mul.
+
+#define FB_BIG       ZEN_CAT(BIG_,ZEN_B)
+#define FB_BIGF(f)   ZEN_CAT3(BIG_,ZEN_B,_##f)
+#define FB_FP        ZEN_CAT(FP_,ZEN_F)
+#define FB_FPF(f)    ZEN_CAT3(FP_,ZEN_F,_##f)
+#define FB_ECP       ZEN_CAT(ECP_,ZEN_C)
+#define FB_ECPF(f)   ZEN_CAT3(ECP_,ZEN_C,_##f)
+#define FB_(f)       ZEN_CAT3(FB_,ZEN_C,_##f)
+#define FB_CURVE(n)  ZEN_CAT(CURVE_##n##_,ZEN_C)
+#define FB_MODBYTES  ZEN_CAT(MODBYTES_,ZEN_B)
+#define FB_EGS       ZEN_CAT(EGS_,ZEN_C)
+// scalars reduced modulo the order fit in 2*MODBYTES nibbles, plus
+// one window for the carry out of the signed recoding
+#define FB_WINDOWS   (2*FB_MODBYTES+1)
+
+// table[i][j] = (j+1) * 16^i * G
+static FB_ECP FB_(table)[FB_WINDOWS][FB_ENTRIES];
+
+static void FB_(build)(void) {
+	FB_BIG x, y;
+	FB_ECP B;
+	int i, j;
+	double start = dtime();
+	FB_BIGF(rcopy)(x, FB_CURVE(Gx));
+	FB_BIGF(rcopy)(y, FB_CURVE(Gy));
+	FB_ECPF(set)(&B, x, y);
+	for(i=0; i<FB_WINDOWS; i++) {
+		FB_ECPF(copy)(&FB_(table)[i][0], &B);
+		for(j=1; j<FB_ENTRIES; j++) {
+			FB_ECPF(copy)(&FB_(table)[i][j], &FB_(table)[i][j-1]);
+			FB_ECPF(add)(&FB_(table)[i][j], &B);
+		}
+		// next base is 16 * B
+		FB_ECPF(copy)(&B, &FB_(table)[i][FB_ENTRIES-1]);
+		FB_ECPF(dbl)(&B);
+	}
+	func(NULL, "Fixed base table for %s built in %.3f ms (%u KiB)",
+	     ZEN_STR(ZEN_C), (dtime()-start)*1000,
+	     (unsigned)(sizeof(FB_(table))/1024));
+}
+
+#if defined(__EMSCRIPTEN__)
+static int FB_(built) = 0;
+static void FB_(table_init)(void) {
+	if(!FB_(built)) {
+		FB_(build)();
+		FB_(built) = 1; }
+}
+#else
+static pthread_once_t FB_(once) = PTHREAD_ONCE_INIT;
+static void FB_(table_init)(void) {
+	pthread_once(&FB_(once), FB_(build));
+}
+#endif
+
+// signed base 16 digits in [-8,7], the last one is 0 or 1
+static void FB_(recode)(signed char *dig, FB_BIG e) {
+	FB_BIG t;
+	int i, v, carry = 0;
+	FB_BIGF(copy)(t, e);
+	FB_BIGF(norm)(t);
+	for(i=0; i<FB_WINDOWS-1; i++) {
+		v = FB_BIGF(fshr)(t, 4) + carry;
+		carry = (v + 8) >> 4;
+		dig[i] = (signed char)(v - (carry << 4));
+	}
+	dig[i] = (signed char)carry;
+	FB_BIGF(zero)(t);
+}
+
+void FB_(mul)(FB_ECP *P, FB_BIG e) {
+	signed char dig[FB_WINDOWS];
+	FB_BIG s, r;
+	FB_ECP T, N;
+	int i, j, d, neg, abs;
+	FB_(table_init)();
+	FB_BIGF(copy)(s, e);
+	FB_BIGF(rcopy)(r, FB_CURVE(Order));
+	FB_BIGF(mod)(s, r);
+	FB_(recode)(dig, s);
+	FB_ECPF(inf)(P);
+	for(i=0; i<FB_WINDOWS; i++) {
+		d = dig[i];
+		neg = (d >> (sizeof(int)*8-1)) & 1;
+		abs = (d ^ -neg) + neg;
+		// scan the whole row to not leak the digit
+		FB_ECPF(inf)(&T);
+		for(j=0; j<FB_ENTRIES; j++)
+			fb_cmove(&T, &FB_(table)[i][j], sizeof(FB_ECP), fb_equal(j+1, abs));
+		FB_ECPF(copy)(&N, &T);
+		FB_ECPF(neg)(&N);
+		fb_cmove(&T, &N, sizeof(FB_ECP), neg);
+		FB_ECPF(add)(P, &T);
+	}
+	memset(dig, 0, sizeof(dig));
+	FB_BIGF(zero)(s);
+}
+
+// same as ECP_<curve>_KEY_PAIR_GENERATE
+int FB_(KEY_PAIR_GENERATE)(csprng *RNG, octet *S, octet *W) {
+	FB_BIG r, s;
+	FB_ECP G;
+	FB_BIGF(rcopy)(r, FB_CURVE(Order));
+	if(RNG != NULL) {
+		FB_BIGF(randomnum)(s, r, RNG);
+	} else {
+		FB_BIGF(fromBytes)(s, S->val);
+		FB_BIGF(mod)(s, r);
+	}
+#ifdef AES_S
+	FB_BIGF(mod2m)(s, 2*AES_S);
+#endif
+	S->len = FB_EGS;
+	FB_BIGF(toBytes)(S->val, s);
+	FB_(mul)(&G, s);
+	FB_ECPF(toOctet)(W, &G);
+	FB_BIGF(zero)(s);
+	return 0;
+}
+
+// same as ECP_<curve>_SP_DSA
+int FB_(SP_DSA)(int sha, csprng *RNG, octet *K, octet *S,
+                octet *F, octet *C, octet *D) {
+	char h[128];
+	octet H = {0, sizeof(h), h};
+	FB_BIG r, s, f, c, d, u, vx, w;
+	FB_ECP V;
+	int hlen;
+	HASH(sha, F, &H);
+	FB_BIGF(rcopy)(r, FB_CURVE(Order));
+	FB_BIGF(fromBytes)(s, S->val);
+	hlen = H.len;
+	if(hlen > FB_MODBYTES) hlen = FB_MODBYTES;
+	FB_BIGF(fromBytesLen)(f, H.val, hlen);
+	if(RNG != NULL) {
+		do {
+			FB_BIGF(randomnum)(u, r, RNG);
+			FB_BIGF(randomnum)(w, r, RNG); // side channel masking
+#ifdef AES_S
+			FB_BIGF(mod2m)(u, 2*AES_S);
+#endif
+			FB_(mul)(&V, u);
+			FB_ECPF(get)(vx, vx, &V);
+			FB_BIGF(copy)(c, vx);
+			FB_BIGF(mod)(c, r);
+			if(FB_BIGF(iszilch)(c)) continue;
+			FB_BIGF(modmul)(u, u, w, r);
+			FB_BIGF(invmodp)(u, u, r);
+			FB_BIGF(modmul)(d, s, c, r);
+			FB_BIGF(add)(d, f, d);
+			FB_BIGF(modmul)(d, d, w, r);
+			FB_BIGF(modmul)(d, u, d, r);
+		} while(FB_BIGF(iszilch)(d));
+	} else {
+		FB_BIGF(fromBytes)(u, K->val);
+		FB_BIGF(mod)(u, r);
+#ifdef AES_S
+		FB_BIGF(mod2m)(u, 2*AES_S);
+#endif
+		FB_(mul)(&V, u);
+		FB_ECPF(get)(vx, vx, &V);
+		FB_BIGF(copy)(c, vx);
+		FB_BIGF(mod)(c, r);
+		if(FB_BIGF(iszilch)(c)) return ECDH_ERROR;
+		FB_BIGF(invmodp)(u, u, r);
+		FB_BIGF(modmul)(d, s, c, r);
+		FB_BIGF(add)(d, f, d);
+		FB_BIGF(modmul)(d, u, d, r);
+		if(FB_BIGF(iszilch)(d)) return ECDH_ERROR;
+	}
+	C->len = D->len = FB_EGS;
+	FB_BIGF(toBytes)(C->val, c);
+	FB_BIGF(toBytes)(D->val, d);
+	FB_BIGF(zero)(s);
+	FB_BIGF(zero)(u);
+	return 0;
+}
+
+// scalar from a signature octet, keeping its last MODBYTES bytes as
+// the OCT_shl in ECP_<curve>_VP_DSA does
+static void FB_(scalar)(FB_BIG b, octet *o) {
+	if(o->len > FB_MODBYTES)
+		FB_BIGF(fromBytesLen)(b, o->val + o->len - FB_MODBYTES, FB_MODBYTES);
+	else
+		FB_BIGF(fromBytesLen)(b, o->val, o->len);
+}
+
+// Same checks as ECP_<curve>_VP_DSA on n signatures (C[i],D[i]) of
+// messages F[i] by public keys W[i], any of which can be NULL. Sets
+// res[i] to 0 for good signatures, ECDH_INVALID or ECDH_ERROR as
+// VP_DSA would return otherwise. Returns the number of good ones or
+// -1 if out of memory.
+int FB_(VP_DSA_BATCH)(int sha, int n, octet **W, octet **F,
+                      octet **C, octet **D, int *res) {
+	typedef struct {
+		FB_BIG c;
+		FB_BIG d;   // becomes 1/d
+		FB_BIG pre; // product of the d before this one
+		FB_FP zpre; // product of the Z before this one
+		FB_ECP R;
+	} item_t;
+	char h[128];
+	octet H = {0, sizeof(h), h};
+	FB_BIG r, f, acc, u1, u2, x, y;
+	FB_FP zacc, zinv;
+	FB_ECP Q;
+	int i, hlen, left = 0, good = 0;
+	item_t *it;
+	if(n <= 0) return 0;
+	it = (item_t*)zen_memory_alloc(n * sizeof(item_t));
+	if(!it) return -1;
+	FB_BIGF(rcopy)(r, FB_CURVE(Order));
+
+	// range checks and running product of the d
+	FB_BIGF(one)(acc);
+	for(i=0; i<n; i++) {
+		res[i] = ECDH_INVALID;
+		if(!W[i] || !F[i] || !C[i] || !D[i]) continue;
+		FB_(scalar)(it[i].c, C[i]);
+		FB_(scalar)(it[i].d, D[i]);
+		if(FB_BIGF(iszilch)(it[i].c) || FB_BIGF(comp)(it[i].c, r) >= 0
+		   || FB_BIGF(iszilch)(it[i].d) || FB_BIGF(comp)(it[i].d, r) >= 0)
+			continue;
+		res[i] = ECDH_OK;
+		FB_BIGF(copy)(it[i].pre, acc);
+		FB_BIGF(modmul)(acc, acc, it[i].d, r);
+		left++;
+	}
+	if(!left) goto done;
+
+	// one inversion for all: 1/d[i] = pre[i] / (d[0]...d[i])
+	FB_BIGF(invmodp)(acc, acc, r);
+	for(i=n-1; i>=0; i--) {
+		if(res[i] != ECDH_OK) continue;
+		FB_BIGF(modmul)(it[i].pre, it[i].pre, acc, r);
+		FB_BIGF(modmul)(acc, acc, it[i].d, r);
+		FB_BIGF(copy)(it[i].d, it[i].pre);
+	}
+
+	// R = f/d * G + c/d * W, the G term from the table: it takes no
+	// doublings, so a joint sum with the W term would not save any
+	for(i=0; i<n; i++) {
+		if(res[i] != ECDH_OK) continue;
+		HASH(sha, F[i], &H);
+		hlen = H.len;
+		if(hlen > FB_MODBYTES) hlen = FB_MODBYTES;
+		FB_BIGF(fromBytesLen)(f, H.val, hlen);
+		FB_BIGF(modmul)(u1, f, it[i].d, r);
+		FB_BIGF(modmul)(u2, it[i].c, it[i].d, r);
+		if(!FB_ECPF(fromOctet)(&Q, W[i])) {
+			res[i] = ECDH_ERROR;
+			continue; }
+		FB_(mul)(&it[i].R, u1);
+		FB_ECPF(mul)(&Q, u2);
+		FB_ECPF(add)(&it[i].R, &Q);
+		if(FB_ECPF(isinf)(&it[i].R)) {
+			res[i] = ECDH_INVALID;
+			continue; }
+	}
+
+	// to affine with one field inversion, same trick on Z
+	FB_FPF(one)(&zacc);
+	for(i=0; i<n; i++) {
+		if(res[i] != ECDH_OK) continue;
+		FB_FPF(copy)(&it[i].zpre, &zacc);
+		FB_FPF(mul)(&zacc, &zacc, &it[i].R.z);
+	}
+	FB_FPF(inv)(&zinv, &zacc);
+	for(i=n-1; i>=0; i--) {
+		if(res[i] != ECDH_OK) continue;
+		FB_FPF(mul)(&it[i].zpre, &it[i].zpre, &zinv);
+		FB_FPF(mul)(&zinv, &zinv, &it[i].R.z);
+		FB_FPF(mul)(&it[i].R.x, &it[i].R.x, &it[i].zpre);
+		FB_FPF(mul)(&it[i].R.y, &it[i].R.y, &it[i].zpre);
+		FB_FPF(reduce)(&it[i].R.x);
+		FB_FPF(reduce)(&it[i].R.y);
+		FB_FPF(one)(&it[i].R.z);
+	}
+
+	for(i=0; i<n; i++) {
+		if(res[i] != ECDH_OK) continue;
+		FB_ECPF(get)(x, y, &it[i].R);
+		FB_BIGF(mod)(x, r);
+		if(FB_BIGF(comp)(x, it[i].c) != 0)
+			res[i] = ECDH_INVALID;
+		else
+			good++;
+	}
+ done:
+	zen_memory_free(it);
+	return good;
+}
+
+#undef FB_BIG
+#undef FB_BIGF
+#undef FB_FP
+#undef FB_FPF
+#undef FB_ECP
+#undef FB_ECPF
+#undef FB_
+#undef FB_CURVE
+#undef FB_MODBYTES
+#undef FB_EGS
+#undef FB_WINDOWS
+#undef ZEN_C
+#undef ZEN_B
+#undef ZEN_F
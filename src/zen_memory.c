@@ -1,11 +1,16 @@
 #include <errno.h>
 #include <stdlib.h>
+#include <string.h>
 #include <jutils.h>
 
 #include <zenroom.h>
 #include <umm_malloc.h>
+#include <zen_slab.h>
+#include <zen_profile.h>
 
-extern void *umm_info(void*);
+extern void *umm_info(void *heap, void *ptr);
+
+void *zen_memory_heap(zen_mem_t *mem, void *ptr, size_t osize, size_t nsize);
 
 void *zen_memalign(const size_t size, const size_t align) {
 	void *mem = NULL;
@@ -34,13 +39,27 @@ void *zen_memalign(const size_t size, const size_t align) {
 	return(mem);
 }
 
-// global memory manager saved here
-// TODO: this is not reentrant (see also umm_malloc.c)
-static zen_mem_t *zen_mem;
+// memory manager of the context active in this thread, used by C
+// code allocating outside of Lua (see zen_memory.h). Lua allocations
+// get their own manager as userdata of zen_memory_manager().
+static ZEN_TLS zen_mem_t *zen_mem;
+
+static void *libc_malloc(void *heap, size_t size) {
+	(void)heap; return malloc(size); }
+static void *libc_realloc(void *heap, void *ptr, size_t size) {
+	(void)heap; return realloc(ptr, size); }
+static void  libc_free(void *heap, void *ptr) {
+	(void)heap; free(ptr); }
 
-// Global HEAP pointer in the STACK
-zen_mem_t *umm_memory_init(size_t S) {
+// new regions of a growable umm heap
+static void *umm_region_alloc(size_t size) {
+	return zen_memalign(size, 8); }
+
+// HEAP area owned by the memory manager: S bytes at start, growing by
+// new regions up to max bytes in total when max is bigger than S
+zen_mem_t *umm_memory_init(size_t S, size_t max) {
 	zen_mem_t *mem = malloc(sizeof(zen_mem_t));
+	if(max && max < S) S = max;
 	mem->heap = zen_memalign(S, 8);
 	mem->heap_size = S;
 	mem->malloc = umm_malloc;
@@ -49,29 +68,67 @@ zen_mem_t *umm_memory_init(size_t S) {
 	mem->sys_malloc = malloc;
 	mem->sys_realloc = realloc;
 	mem->sys_free = free;
+	mem->slab = NULL;
+	mem->prof = NULL;
+	mem->arena = NULL;
 	umm_init(mem->heap, mem->heap_size);
+	if(max > S)
+		umm_growable(mem->heap, umm_region_alloc, free, max);
 	zen_mem = mem;
 	return mem;
-	// pointers saved in umm_malloc.c (stack)
 }
 
 zen_mem_t *libc_memory_init() {
 	zen_mem_t *mem = malloc(sizeof(zen_mem_t));
 	mem->heap = NULL;
 	mem->heap_size = 0;
-	mem->malloc = malloc;
-	mem->realloc = realloc;
-	mem->free = free;
+	mem->malloc = libc_malloc;
+	mem->realloc = libc_realloc;
+	mem->free = libc_free;
 	mem->sys_malloc = malloc;
 	mem->sys_realloc = realloc;
 	mem->sys_free = free;
+	mem->slab = NULL;
+	mem->prof = NULL;
+	mem->arena = NULL;
 	zen_mem = mem;
 	return mem;
 }
 
-void *zen_memory_alloc(size_t size) { return (*zen_mem->malloc)(size); }
-void *zen_memory_realloc(void *ptr, size_t size) { return (*zen_mem->realloc)(ptr, size); }
-void  zen_memory_free(void *ptr) { (*zen_mem->free)(ptr); }
+// make mem the memory manager of the calling thread: to be called
+// before operating on a context, when more than one is alive
+void zen_memory_activate(zen_mem_t *mem) {
+	zen_mem = mem;
+}
+
+// image of a umm heap, restored by copying it back at the same
+// address: pointers inside the heap are absolute and the Lua state
+// lives entirely inside it, so the copy cannot be relocated. The image
+// covers all regions of a growable heap and starts with its size.
+void *zen_memory_snapshot(zen_mem_t *mem) {
+	if(!mem->heap) return NULL;
+	size_t size = umm_image_size(mem->heap);
+	size_t *img = malloc(sizeof(size_t) + size);
+	if(!img) {
+		error(0, "%s: cannot allocate %u bytes", __func__, size);
+		return NULL; }
+	img[0] = size;
+	umm_image_save(mem->heap, &img[1]);
+	return img;
+}
+
+void zen_memory_restore(zen_mem_t *mem, void *img) {
+	size_t *image = (size_t*)img;
+	umm_image_load(mem->heap, &image[1], image[0]);
+}
+
+size_t zen_memory_snapshot_size(void *img) {
+	return ((size_t*)img)[0];
+}
+
+void *zen_memory_alloc(size_t size) { return (*zen_mem->malloc)(zen_mem->heap, size); }
+void *zen_memory_realloc(void *ptr, size_t size) { return (*zen_mem->realloc)(zen_mem->heap, ptr, size); }
+void  zen_memory_free(void *ptr) { (*zen_mem->free)(zen_mem->heap, ptr); }
 void *system_alloc(size_t size) { return (*zen_mem->sys_malloc)(size); }
 void *system_realloc(void *ptr, size_t size) { return (*zen_mem->sys_realloc)(ptr, size); }
 void  system_free(void *ptr) { (*zen_mem->sys_free)(ptr); }
@@ -92,6 +149,18 @@ void  system_free(void *ptr) { (*zen_mem->sys_free)(ptr); }
  */
 void *zen_memory_manager(void *ud, void *ptr, size_t osize, size_t nsize) {
 	zen_mem_t *mem = (zen_mem_t*)ud;
+	if(mem->prof)
+		return zen_prof_manager(mem, ptr, osize, nsize);
+	return zen_memory_heap(mem, ptr, osize, nsize);
+}
+
+// allocations below the profiler: slab or heap
+void *zen_memory_heap(zen_mem_t *mem, void *ptr, size_t osize, size_t nsize) {
+	if(mem->slab) {
+		void *ret = zen_slab_manager(mem, ptr, osize, nsize);
+		if(!ret && nsize)
+			error(NULL,"Malloc out of memory, requested %u B",nsize);
+		return ret; }
 	if(ptr == NULL) {
 		// When ptr is NULL, osize encodes the kind of object that Lua
 		// is allocating. osize is any of LUA_TSTRING, LUA_TTABLE,
@@ -100,10 +169,10 @@ void *zen_memory_manager(void *ud, void *ptr, size_t osize, size_t nsize) {
 		// is some other value, Lua is allocating memory for something
 		// else.
 		if(nsize!=0) {
-			void *ret = (*mem->malloc)(nsize);
+			void *ret = (*mem->malloc)(mem->heap, nsize);
 			if(ret) return ret;
 			error(NULL,"Malloc out of memory, requested %u B",nsize);
-			umm_info(mem->heap);
+			if(mem->heap) umm_info(mem->heap, NULL);
 			return NULL;
 		} else return NULL;
 
@@ -114,7 +183,7 @@ void *zen_memory_manager(void *ud, void *ptr, size_t osize, size_t nsize) {
 		if(nsize==0) {
 			// When nsize is zero, the allocator must behave like free
 			// and return NULL.
-			(*mem->free)(ptr);
+			(*mem->free)(mem->heap, ptr);
 			return NULL; }
 
 		// When nsize is not zero, the allocator must behave like
@@ -122,9 +191,9 @@ void *zen_memory_manager(void *ud, void *ptr, size_t osize, size_t nsize) {
 		// cannot fulfill the request. Lua assumes that the allocator
 		// never fails when osize >= nsize.
 		if(osize >= nsize) { // shrink
-			return (*mem->realloc)(ptr, nsize);
+			return (*mem->realloc)(mem->heap, ptr, nsize);
 		} else { // extend
-			return (*mem->realloc)(ptr, nsize);
+			return (*mem->realloc)(mem->heap, ptr, nsize);
 		}
 	}
 }
@@ -55,46 +55,26 @@
 #include <jutils.h>
 #include <zen_error.h>
 #include <lua_functions.h>
-#include <randombytes.h>
 
 #include <amcl.h>
 
 #include <zenroom.h>
 #include <zen_memory.h>
+#include <zen_arena.h>
+#include <zen_octet.h>
+#include <zen_codec.h>
+#include <zen_random.h>
 
 static int _max(int x, int y) { if(x > y) return x;	else return y; }
 // static int _min(int x, int y) { if(x < y) return x;	else return y; }
 
-// takes a base64 string and calculated the maximum length of the
-// decoded string
-#include <ctype.h>
-static int getlen_base64(int len) {
-	int res = ((3+(4*(len/3))) & ~0x03)+0x0f;
-	return(res);
-}
-// assumes null terminated string
-// returns 0 if not base64 else length of base64 string
-int is_base64(const char *in) {
-	if(!in) { ERROR(); return 0; }
-	int c;
-	for(c=0; in[c]!='\0'; c++) {
-		if (!(isalnum(in[c])
-		      || '+' == in[c]
-		      || '=' == in[c]
-		      || '/' == in[c])) {
-			ERROR(); return 0; }
-	}
-	return c;
-}
-
-int is_hex(const char *in) {
-	if(!in) { ERROR(); return 0; }
-	int c;
-	for(c=0; in[c]!='\0'; c++) {
-		if (!isxdigit(in[c])) {
-		    ERROR(); return 0; }
-	}
-	return c;
+// base64 and hex strings are validated while decoded (zen_codec.c)
+static int o_decode_error(lua_State *L, long res, const char *format) {
+	if(res == ZEN_CODEC_OVERFLOW)
+		lerror(L, "%s string too long for octet", format);
+	else
+		lerror(L, "%s string contains invalid characters", format);
+	return 0;
 }
 
 // REMEMBER: newuserdata already pushes the object in lua's stack
@@ -103,14 +83,25 @@ octet* o_new(lua_State *L, const int size) {
 	if(size>MAX_FILE) {
 		lerror(L, "Cannot create octet, size too big: %u", size);
 		return NULL; }
-	octet *o = (octet *)lua_newuserdata(L, sizeof(octet));
+	int inline_val = (size+2 <= OCTET_INLINE);
+	octet *o = (octet *)lua_newuserdata(L, inline_val ?
+	                                    sizeof(octet)+size+2 : sizeof(octet));
 	if(!o) {
 		lerror(L, "Error allocating new octet in %s",__func__);
 		return NULL; }
 	// TODO: check that maximum is not exceeded
 	luaL_getmetatable(L, "zenroom.octet");
 	lua_setmetatable(L, -2);
-	o->val = zen_memory_alloc(size+2);
+	if(inline_val)
+		o->val = (char*)(o+1);
+	else {
+		// payload from the arena when enabled, else from the heap
+		zen_mem_t *mem;
+		lua_getallocf(L, (void**)&mem);
+		o->val = zen_arena_alloc(mem, (void**)&o->val, size+2);
+		if(!o->val)
+			o->val = zen_memory_alloc(size+2);
+	}
 	o->len = 0;
 	o->max = size;
 	func(L, "new octet (%u bytes)",size);
@@ -139,7 +130,14 @@ int o_destroy(lua_State *L) {
 	HERE();
 	octet *o = o_arg(L,1);
 	SAFE(o);
-	zen_memory_free(o->val);
+	if(o->val == (char*)(o+1)) // inline, freed with the userdata
+		return 0;
+	if(lua_getuservalue(L, 1) != LUA_TNIL) // view, bytes of the parent
+		return 0;
+	zen_mem_t *mem;
+	lua_getallocf(L, (void**)&mem);
+	if(!zen_arena_free(mem, o->val))
+		zen_memory_free(o->val);
 	return 0;
 }
 
@@ -203,14 +201,17 @@ static int xor_n(lua_State *L) {
 }
 
 static int from_base64(lua_State *L) {
-	const char *s = lua_tostring(L, 1);
+	size_t len;
+	const char *s = lua_tolstring(L, 1, &len);
 	luaL_argcheck(L, s != NULL, 1, "base64 string expected");
-	int len = is_base64(s);
 	if(!len) {
-		lerror(L, "base64 string contains invalid characters");
+		lerror(L, "base64 string is empty");
 		return 0; }
-	octet *o = o_new(L, getlen_base64(len));
-	OCT_frombase64(o,(char*)s);
+	octet *o = o_new(L, B64_DECLEN(len));
+	SAFE(o);
+	long res = zen_base64_decode((unsigned char*)o->val, o->max, s, len);
+	if(res < 0) return o_decode_error(L, res, "base64");
+	o->len = res;
 	return 1;
 }
 
@@ -227,14 +228,17 @@ static int from_string(lua_State *L) {
 }
 
 static int from_hex(lua_State *L) {
-	const char *s = lua_tostring(L, 1);
+	size_t len;
+	const char *s = lua_tolstring(L, 1, &len);
 	luaL_argcheck(L, s != NULL, 1, "hex string sequence expected");
-	int len = is_hex(s);
-	if(!len || len>MAX_STRING*2) {
+	if(!len || len>MAX_STRING*2 || len&1) {
 		lerror(L, "invalid hex sequence size: %u", len);
 		return 0; }
-	octet *o = o_new(L, len); // could be half size
-	OCT_fromHex(o, (char*)s);
+	octet *o = o_new(L, len/2);
+	SAFE(o);
+	long res = zen_hex_decode((unsigned char*)o->val, o->max, s, len);
+	if(res < 0) return o_decode_error(L, res, "hex");
+	o->len = res;
 	return 1;
 }
 
@@ -323,17 +327,19 @@ static int base64 (lua_State *L) {
 		if(!o->len) {
 			lerror(L, "base64 import of empty string");
 			return 0; }
-		int newlen = getlen_base64(o->len);
-		char *b = zen_memory_alloc(newlen+2);
-		OCT_tobase64(b,o);
-		b[newlen] = 0;
-		lua_pushstring(L,b);
-		zen_memory_free(b);
+		luaL_Buffer b;
+		size_t newlen = B64_ENCLEN(o->len);
+		char *p = luaL_buffinitsize(L, &b, newlen);
+		zen_base64_encode(p, (unsigned char*)o->val, o->len);
+		luaL_pushresultsize(&b, newlen);
 	} else {
 		// import from base64
-		const char *s = lua_tostring(L, 2);
+		size_t len;
+		const char *s = lua_tolstring(L, 2, &len);
 		luaL_argcheck(L, s != NULL, 2, "base64 string expected");
-		OCT_frombase64(o,(char*)s);
+		long res = zen_base64_decode((unsigned char*)o->val, o->max, s, len);
+		if(res < 0) return o_decode_error(L, res, "base64");
+		o->len = res;
 	}
 	return 1;
 }
@@ -377,17 +383,18 @@ static int hex(lua_State *L) {
 	octet *o = o_arg(L,1);	SAFE(o);
 	if(lua_isnoneornil(L, 2)) {
 		// export to hex
-		char *s = zen_memory_alloc(o->len*2+2);
-		OCT_toHex(o,s);
-		s[o->len*2] = 0;
-		lua_pushstring(L,s);
-		zen_memory_free(s);
+		luaL_Buffer b;
+		char *p = luaL_buffinitsize(L, &b, o->len*2);
+		zen_hex_encode(p, (unsigned char*)o->val, o->len);
+		luaL_pushresultsize(&b, o->len*2);
 	} else {
 		// import from hex
 		size_t len;
 		const char *s = lua_tolstring(L, 2, &len);
 		luaL_argcheck(L, s != NULL, 2, "string expected");
-		OCT_fromHex(o,(char*)s);
+		long res = zen_hex_decode((unsigned char*)o->val, o->max, s, len);
+		if(res < 0) return o_decode_error(L, res, "hex");
+		o->len = res;
 	}
 	return 1;
 }
@@ -401,12 +408,13 @@ static int hex(lua_State *L) {
 */
 static int o_random(lua_State *L) {
 	octet *o = o_arg(L,1);	SAFE(o);
-	const int len = luaL_optinteger(L, 2, o->max);
-	char *buf = zen_memory_alloc(len+2);
-	randombytes(buf,len);
-	o->len=0;
-	OCT_jbytes(o,buf,len);
-	zen_memory_free(buf);
+	int len = luaL_optinteger(L, 2, o->max);
+	if(len > o->max) len = o->max;
+	if(len < 0) len = 0;
+	if(!zen_random_bytes(L,o->val,len)) {
+		lerror(L, "%s: random generator failed",__func__);
+		return 0; }
+	o->len = len;
 	return 1;
 }
 
@@ -476,6 +484,53 @@ static int concat_i(lua_State *L) {
 	// TODO: support strings
 }
 
+/***
+    Take a view of this octet from byte i to byte j included; negative
+    positions count from the end, as in string.sub. The view is an
+    octet sharing the bytes of this one, no copy is made: changes made
+    through one are seen by the other and this octet is kept alive as
+    long as the view is. A view cannot grow beyond its initial length.
+
+    @int[opt=1] i first byte
+    @int[opt=-1] j last byte
+    @function octet:sub(i,j)
+    @return octet view of bytes i to j
+    @usage
+-- split a framed ciphertext IV|ct|tag without copies
+iv, ct, tag = frame:sub(1,16), frame:sub(17,-17), frame:sub(-16)
+*/
+static int sub(lua_State *L) {
+	octet *o = o_arg(L,1);	SAFE(o);
+	lua_Integer i = luaL_optinteger(L, 2, 1);
+	lua_Integer j = luaL_optinteger(L, 3, -1);
+	if(i < 0) i = o->len + i + 1;
+	if(j < 0) j = o->len + j + 1;
+	if(i < 1) i = 1;
+	if(j > o->len) j = o->len;
+	if(i > j) {
+		lerror(L, "%s: empty range %d..%d of octet of %d bytes",
+		       __func__, (int)i, (int)j, o->len);
+		return 0; }
+	// arena payloads are moved at the end of the execution, so the
+	// parent must hold its bytes in the heap before they are shared
+	zen_mem_t *mem;
+	lua_getallocf(L, (void**)&mem);
+	if(!zen_arena_promote(mem, (void**)&o->val)) {
+		lerror(L, "%s: out of memory", __func__);
+		return 0; }
+	octet *v = (octet *)lua_newuserdata(L, sizeof(octet));
+	luaL_getmetatable(L, "zenroom.octet");
+	lua_setmetatable(L, -2);
+	v->val = o->val + i - 1;
+	v->len = j - i + 1;
+	v->max = v->len;
+	// the parent is the uservalue of the view
+	lua_pushvalue(L, 1);
+	lua_setuservalue(L, -2);
+	func(L, "new octet view (%u bytes at %u)", v->len, (unsigned)(i-1));
+	return 1;
+}
+
 static int size(lua_State *L) {
 	octet *o = o_arg(L,1); SAFE(o);
 	lua_pushinteger(L,o->len);
@@ -508,6 +563,7 @@ static int max(lua_State *L) {
     {"size", size},           \
 	{"random", o_random},       \
 	{"pad", pad},             \
+	{"sub", sub},             \
     {"eq", eq}, \
     {"max", max}
 
@@ -4,6 +4,10 @@
 
 #include <amcl.h>
 
+// payloads up to this size (keys, hashes, points) are stored in the
+// same userdata block as the octet, bigger ones are allocated apart
+#define OCTET_INLINE 256
+
 // REMEMBER: o_new already pushes the object in lua's stack
 octet* o_new(lua_State *L, const int size);
 
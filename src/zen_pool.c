@@ -0,0 +1,330 @@
+/*  Zenroom (DECODE project)
+ *
+ *  (c) Copyright 2017-2018 Dyne.org foundation
+ *  designed, written and maintained by Denis Roio <jaromil@dyne.org>
+ *
+ * This source code is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Public License as published
+ * by the Free Software Foundation; either version 3 of the License,
+ * or (at your option) any later version.
+ *
+ * This source code is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * Please refer to the GNU Public License for more details.
+ *
+ * You should have received a copy of the GNU Public License along with
+ * this source code; if not, write to:
+ * Free Software Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+
+// Pool of pre-initialised zenroom contexts. Creating a context runs
+// luaL_openlibs and all the embedded extensions loaded by init.lua,
+// which costs much more than most scripts we execute; the pool pays
+// that once and between executions restores each context to its
+// post-init state.
+//
+// With the umm memory manager the whole Lua state lives in the heap
+// arena, so an image of it is saved after initialisation and reset is
+// a single memcpy back in place (see zen_snapshot in zenroom.c).
+//
+// Otherwise the reset works on the Lua side: after initialisation a
+// shallow copy of the global table, of every table reachable from it
+// and of every table named in the registry (loaded modules, class
+// metatables) is saved in the registry. Reset drops any key added
+// since, restores the saved values and metatables and runs a full
+// GC. State hidden deeper than one level of tables, or in upvalues of
+// module functions, is not covered.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <lua.h>
+#include <lualib.h>
+#include <lauxlib.h>
+
+#include <jutils.h>
+#include <zenroom.h>
+#include <zen_random.h>
+
+// prototypes from zen_memory.c
+extern void zen_memory_activate(zen_mem_t *mem);
+
+// prototypes from lua_functions.c
+extern char *safe_string(char *str);
+extern void zen_setenv(lua_State *L, char *key, char *val);
+
+#define ZEN_PRISTINE "zen_pristine"
+
+// pushes a shallow copy of the table at idx
+static void pool_copy(lua_State *L, int idx) {
+	idx = lua_absindex(L, idx);
+	lua_newtable(L);
+	lua_pushnil(L);
+	while(lua_next(L, idx)) {
+		lua_pushvalue(L, -2);
+		lua_insert(L, -2);
+		lua_rawset(L, -4);
+	}
+}
+
+// saves { copy, metatable } of the table at idx in the snapshot
+static void pool_track(lua_State *L, int snap, int idx) {
+	idx = lua_absindex(L, idx);
+	lua_pushvalue(L, idx);
+	if(lua_rawget(L, snap) != LUA_TNIL) { // already tracked
+		lua_pop(L, 1);
+		return; }
+	lua_pop(L, 1);
+	lua_pushvalue(L, idx);
+	lua_createtable(L, 2, 0);
+	pool_copy(L, idx);
+	lua_rawseti(L, -2, 1);
+	if(lua_getmetatable(L, idx))
+		lua_rawseti(L, -2, 2);
+	lua_rawset(L, snap);
+}
+
+// track all tables found as values in the table at idx
+static void pool_track_all(lua_State *L, int snap, int idx) {
+	idx = lua_absindex(L, idx);
+	lua_pushnil(L);
+	while(lua_next(L, idx)) {
+		if(lua_type(L, -1) == LUA_TTABLE)
+			pool_track(L, snap, -1);
+		lua_pop(L, 1);
+	}
+}
+
+int zen_pristine(zenroom_t *Z) {
+	lua_State *L = (lua_State*)Z->lua;
+	lua_newtable(L);
+	int snap = lua_gettop(L);
+
+	lua_pushglobaltable(L);
+	pool_track(L, snap, -1);
+	pool_track_all(L, snap, -1);
+	lua_pop(L, 1);
+
+	// string methods are reachable from any string
+	lua_pushliteral(L, "");
+	if(lua_getmetatable(L, -1)) {
+		pool_track(L, snap, -1);
+		lua_pop(L, 1); }
+	lua_pop(L, 1);
+
+	// loaded modules and class metatables
+	lua_pushnil(L);
+	while(lua_next(L, LUA_REGISTRYINDEX)) {
+		if(lua_type(L, -2) == LUA_TSTRING
+		   && lua_type(L, -1) == LUA_TTABLE
+		   && strcmp(lua_tostring(L, -2), ZEN_PRISTINE) != 0)
+			pool_track(L, snap, -1);
+		lua_pop(L, 1);
+	}
+
+	lua_setfield(L, LUA_REGISTRYINDEX, ZEN_PRISTINE);
+	return 1;
+}
+
+int zen_reset(zenroom_t *Z) {
+	lua_State *L = (lua_State*)Z->lua;
+	if(lua_getfield(L, LUA_REGISTRYINDEX, ZEN_PRISTINE) != LUA_TTABLE) {
+		lua_pop(L, 1);
+		error(L, "%s: context has no pristine state saved", __func__);
+		return 0; }
+	int snap = lua_gettop(L);
+	lua_pushnil(L);
+	while(lua_next(L, snap)) {
+		int tbl = lua_gettop(L) - 1;
+		int ent = lua_gettop(L);
+		lua_rawgeti(L, ent, 1);
+		int copy = lua_gettop(L);
+		// drop keys added after the snapshot
+		lua_pushnil(L);
+		while(lua_next(L, tbl)) {
+			lua_pop(L, 1);
+			lua_pushvalue(L, -1);
+			if(lua_rawget(L, copy) == LUA_TNIL) {
+				lua_pushvalue(L, -2);
+				lua_pushnil(L);
+				lua_rawset(L, tbl); }
+			lua_pop(L, 1);
+		}
+		// restore saved values
+		lua_pushnil(L);
+		while(lua_next(L, copy)) {
+			lua_pushvalue(L, -2);
+			lua_insert(L, -2);
+			lua_rawset(L, tbl);
+		}
+		lua_rawgeti(L, ent, 2);
+		lua_setmetatable(L, tbl);
+		lua_pop(L, 2); // copy and entry
+	}
+	lua_pop(L, 1);
+
+	Z->stdout_buf = NULL;
+	Z->stdout_pos = 0;
+	Z->stdout_len = 0;
+	Z->stderr_buf = NULL;
+	Z->stderr_pos = 0;
+	Z->stderr_len = 0;
+
+	lua_gc(L, LUA_GCCOLLECT, 0);
+	return 1;
+}
+
+static int pool_slot(zen_pool_t *P, zenroom_t *Z) {
+	int c;
+	for(c=0; c<P->size; c++)
+		if(P->ctx[c] == Z) return c;
+	return -1;
+}
+
+zen_pool_t *zen_pool_init(const char *conf, int size) {
+	if(size < 1) {
+		error(NULL, "%s: invalid pool size %i", __func__, size);
+		return NULL; }
+	double start = dtime();
+	zen_pool_t *P = malloc(sizeof(zen_pool_t));
+	if(!P) {
+		error(NULL, "%s: cannot allocate the pool", __func__);
+		return NULL; }
+	P->ctx  = calloc(size, sizeof(zenroom_t*));
+	P->busy = calloc(size, sizeof(char));
+	P->lat  = calloc(size, sizeof(double));
+	if(!P->ctx || !P->busy || !P->lat) {
+		error(NULL, "%s: cannot allocate a pool of %i contexts",
+		      __func__, size);
+		free(P->ctx);
+		free(P->busy);
+		free(P->lat);
+		free(P);
+		return NULL; }
+	P->size = size;
+	P->target = ZEN_POOL_TARGET;
+	P->calls = 0;
+	P->over_target = 0;
+	P->total_lat = 0.0;
+	P->peak_lat = 0.0;
+	int c;
+	for(c=0; c<size; c++) {
+		zenroom_t *Z = zen_init(conf, NULL, NULL);
+		if(!Z) {
+			error(NULL, "%s: initialisation of context %i failed",
+			      __func__, c);
+			P->size = c;
+			zen_pool_teardown(P);
+			return NULL; }
+		P->ctx[c] = Z;
+		if(Z->mem->heap) {
+			if(!zen_snapshot(Z)) {
+				P->size = c+1;
+				zen_pool_teardown(P);
+				return NULL; }
+		} else
+			zen_pristine(Z);
+	}
+	act(NULL, "VM pool of %i contexts initialised in %.3f ms",
+	    size, (dtime()-start)*1000);
+	return P;
+}
+
+zenroom_t *zen_pool_acquire(zen_pool_t *P, char *keys, char *data) {
+	double start = dtime();
+	int c;
+	for(c=0; c<P->size; c++)
+		if(!P->busy[c]) break;
+	if(c == P->size) {
+		error(NULL, "%s: all %i contexts are in use", __func__, P->size);
+		return NULL; }
+	zenroom_t *Z = P->ctx[c];
+	lua_State *L = (lua_State*)Z->lua;
+	zen_memory_activate(Z->mem);
+	if(data) // avoid errors on NULL args
+		if(safe_string(data)) {
+			func(L, "declaring global: DATA");
+			zen_setenv(L,"DATA",data);
+		}
+	if(keys)
+		if(safe_string(keys)) {
+			func(L, "declaring global: KEYS");
+			zen_setenv(L,"KEYS",keys);
+		}
+	P->busy[c] = 1;
+	P->lat[c] = dtime() - start;
+	return Z;
+}
+
+void zen_pool_release(zen_pool_t *P, zenroom_t *Z) {
+	double start = dtime();
+	int c = pool_slot(P, Z);
+	if(c < 0 || !P->busy[c]) {
+		error(NULL, "%s: context %p is not acquired from this pool",
+		      __func__, Z);
+		return; }
+	zen_memory_activate(Z->mem);
+	if(Z->snapshot)
+		zen_restore(Z);
+	else
+		zen_reset(Z);
+	zen_random_reset(Z);
+	P->busy[c] = 0;
+	double lat = P->lat[c] + dtime() - start;
+	P->calls++;
+	P->total_lat += lat;
+	if(lat > P->peak_lat) P->peak_lat = lat;
+	if(lat > P->target) {
+		P->over_target++;
+		func(NULL, "%s: acquire+release took %.3f ms (target %.3f ms)",
+		     __func__, lat*1000, P->target*1000);
+	}
+}
+
+void zen_pool_teardown(zen_pool_t *P) {
+	int c;
+	if(P->calls)
+		act(NULL, "VM pool: %lu executions, latency avg %.3f ms peak %.3f ms, %lu over target of %.3f ms",
+		    P->calls, (P->total_lat / P->calls)*1000, P->peak_lat*1000,
+		    P->over_target, P->target*1000);
+	for(c=0; c<P->size; c++) {
+		if(!P->ctx[c]) continue;
+		if(P->busy[c])
+			warning(NULL, "%s: context %i still in use", __func__, c);
+		zen_teardown(P->ctx[c]);
+	}
+	free(P->ctx);
+	free(P->busy);
+	free(P->lat);
+	free(P);
+}
+
+int zenroom_pool_exec_tobuf(zen_pool_t *P, char *script,
+                            char *keys, char *data,
+                            char *stdout_buf, size_t stdout_len,
+                            char *stderr_buf, size_t stderr_len) {
+	zenroom_t *Z;
+	int r;
+	if(!script) {
+		error(NULL, "NULL string as script for %s()", __func__);
+		return 1; }
+	Z = zen_pool_acquire(P, keys, data);
+	if(!Z) return 1;
+
+	// setup stdout and stderr buffers
+	Z->stdout_buf = stdout_buf;
+	Z->stdout_len = stdout_len;
+	Z->stderr_buf = stderr_buf;
+	Z->stderr_len = stderr_len;
+
+	r = zen_exec_script(Z, script);
+	if(r)
+		error((lua_State*)Z->lua, "Error detected. Execution aborted.");
+	else
+		notice((lua_State*)Z->lua, "Zenroom operations completed.");
+
+	zen_pool_release(P, Z);
+	return(r ? 1 : 0);
+}
@@ -0,0 +1,242 @@
+/*  Zenroom (DECODE project)
+ *
+ *  (c) Copyright 2017-2018 Dyne.org foundation
+ *  designed, written and maintained by Denis Roio <jaromil@dyne.org>
+ *
+ * This source code is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Public License as published
+ * by the Free Software Foundation; either version 3 of the License,
+ * or (at your option) any later version.
+ *
+ * This source code is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * Please refer to the GNU Public License for more details.
+ *
+ * You should have received a copy of the GNU Public License along with
+ * this source code; if not, write to:
+ * Free Software Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+
+// Allocation profiler selected with conf "profile". When Lua creates
+// an object the allocator is told its type (osize is LUA_TSTRING,
+// LUA_TTABLE, etc.), but frees and reallocations only tell the size:
+// so the type is saved in a header in front of each block. Live and
+// peak bytes, counts and time spent in the allocator are kept per
+// object type and per power of two size bucket, reported at teardown
+// and returned to Lua by memory_profile().
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <sys/time.h>
+
+#include <lua.h>
+#include <lauxlib.h>
+
+#include <jutils.h>
+#include <zenroom.h>
+#include <zen_profile.h>
+
+// prototypes from zen_memory.c
+extern void *zen_memory_heap(zen_mem_t *mem, void *ptr, size_t osize, size_t nsize);
+
+// Lua 5.3 allocates function prototypes with the internal tag
+// LUA_TPROTO, which follows the public ones
+#define PROF_TPROTO LUA_NUMTAGS
+
+static const char *prof_type_name[PROF_TYPES] = {
+	"other", "string", "table", "function", "userdata", "thread", "proto" };
+
+static inline int prof_type(size_t osize) {
+	switch(osize) {
+	case LUA_TSTRING:   return 1;
+	case LUA_TTABLE:    return 2;
+	case LUA_TFUNCTION: return 3;
+	case LUA_TUSERDATA: return 4;
+	case LUA_TTHREAD:   return 5;
+	case PROF_TPROTO:   return 6;
+	default:            return 0; // arrays, hash parts, upvalues, buffers
+	}
+}
+
+static inline int prof_bucket(size_t size) {
+	int b = 0;
+	size_t top = 16;
+	while(size > top && b < PROF_BUCKETS-1) {
+		top <<= 1;
+		b++; }
+	return b;
+}
+
+static inline double prof_clock() {
+#if defined(CLOCK_MONOTONIC)
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (double)ts.tv_sec + 1.0e-9*(double)ts.tv_nsec;
+#else
+	return dtime();
+#endif
+}
+
+static inline void prof_add(zen_prof_stat_t *s, size_t size) {
+	s->live += size;
+	if(s->live > s->peak) s->peak = s->live;
+}
+
+// the profiler state lives in the heap, so it is part of heap snapshots
+int zen_prof_init(zen_mem_t *mem) {
+	zen_prof_t *P = (*mem->malloc)(mem->heap, sizeof(zen_prof_t));
+	if(!P) {
+		error(NULL, "%s: cannot allocate profiler", __func__);
+		return 0; }
+	memset(P, 0, sizeof(zen_prof_t));
+	mem->prof = P;
+	act(NULL, "Memory profiler of Lua allocations enabled");
+	return 1;
+}
+
+// same arguments as zen_memory_manager(), see lua_Alloc
+void *zen_prof_manager(zen_mem_t *mem, void *ptr, size_t osize, size_t nsize) {
+	zen_prof_t *P = (zen_prof_t*)mem->prof;
+	unsigned char *blk, *ret;
+	int t, bo, bn;
+	double start = prof_clock();
+
+	if(!ptr) { // osize is the type of object, not a size
+		if(!nsize) return NULL;
+		blk = zen_memory_heap(mem, NULL, osize, nsize + PROF_HDR);
+		if(!blk) return NULL;
+		t = prof_type(osize);
+		bn = prof_bucket(nsize);
+		blk[0] = (unsigned char)t;
+		P->type[t].allocs++;
+		P->bucket[bn].allocs++;
+		ret = blk + PROF_HDR;
+	} else {
+		blk = (unsigned char*)ptr - PROF_HDR;
+		t = blk[0];
+		bo = prof_bucket(osize);
+		if(!nsize) {
+			zen_memory_heap(mem, blk, osize + PROF_HDR, 0);
+			P->type[t].frees++;
+			P->type[t].live -= osize;
+			P->bucket[bo].frees++;
+			P->bucket[bo].live -= osize;
+			P->live -= osize;
+			start = prof_clock() - start;
+			P->type[t].time += start;
+			P->bucket[bo].time += start;
+			return NULL; }
+		blk = zen_memory_heap(mem, blk, osize + PROF_HDR, nsize + PROF_HDR);
+		if(!blk) return NULL;
+		bn = prof_bucket(nsize);
+		P->type[t].reallocs++;
+		P->type[t].live -= osize;
+		P->bucket[bo].live -= osize;
+		P->bucket[bn].reallocs++;
+		P->live -= osize;
+		ret = blk + PROF_HDR;
+	}
+	prof_add(&P->type[t], nsize);
+	prof_add(&P->bucket[bn], nsize);
+	P->live += nsize;
+	if(P->live > P->peak) P->peak = P->live;
+	start = prof_clock() - start;
+	P->type[t].time += start;
+	P->bucket[bn].time += start;
+	return ret;
+}
+
+void zen_prof_report(zen_mem_t *mem) {
+	zen_prof_t *P = (zen_prof_t*)mem->prof;
+	int c;
+	act(NULL, "PROFILE of Lua allocations: %u B live, %u B peak",
+	    P->live, P->peak);
+	act(NULL, "PROFILE %-8s %8s %8s %8s %10s %10s %9s",
+	    "type", "allocs", "reallocs", "frees", "live B", "peak B", "time ms");
+	for(c=0; c<PROF_TYPES; c++) {
+		zen_prof_stat_t *s = &P->type[c];
+		if(!s->allocs) continue;
+		act(NULL, "PROFILE %-8s %8lu %8lu %8lu %10u %10u %9.3f",
+		    prof_type_name[c], s->allocs, s->reallocs, s->frees,
+		    s->live, s->peak, s->time*1000);
+	}
+	act(NULL, "PROFILE %-8s %8s %8s %8s %10s %10s %9s",
+	    "size", "allocs", "reallocs", "frees", "live B", "peak B", "time ms");
+	for(c=0; c<PROF_BUCKETS; c++) {
+		zen_prof_stat_t *s = &P->bucket[c];
+		char size[16];
+		if(!s->allocs && !s->reallocs) continue;
+		if(c < PROF_BUCKETS-1)
+			snprintf(size, sizeof(size), "<=%u", 16u << c);
+		else
+			snprintf(size, sizeof(size), ">%u", 16u << (c-1));
+		act(NULL, "PROFILE %-8s %8lu %8lu %8lu %10u %10u %9.3f",
+		    size, s->allocs, s->reallocs, s->frees,
+		    s->live, s->peak, s->time*1000);
+	}
+}
+
+// to be called after lua_close, when no block is in use anymore
+void zen_prof_teardown(zen_mem_t *mem) {
+	(*mem->free)(mem->heap, mem->prof);
+	mem->prof = NULL;
+}
+
+static void prof_push_stat(lua_State *L, zen_prof_stat_t *s) {
+	lua_createtable(L, 0, 6);
+	lua_pushinteger(L, s->allocs);
+	lua_setfield(L, -2, "allocs");
+	lua_pushinteger(L, s->reallocs);
+	lua_setfield(L, -2, "reallocs");
+	lua_pushinteger(L, s->frees);
+	lua_setfield(L, -2, "frees");
+	lua_pushinteger(L, s->live);
+	lua_setfield(L, -2, "live");
+	lua_pushinteger(L, s->peak);
+	lua_setfield(L, -2, "peak");
+	lua_pushnumber(L, s->time);
+	lua_setfield(L, -2, "time");
+}
+
+// returns { live, peak, types = { string = { allocs, ... } ... },
+// buckets = { { max = 16, allocs, ... } ... } } or nil when the
+// profiler is not enabled. The figures are taken before the tables
+// returned are allocated.
+static int lua_memory_profile(lua_State *L) {
+	zen_mem_t *mem;
+	zen_prof_t P;
+	int c;
+	lua_getallocf(L, (void**)&mem);
+	if(!mem->prof) {
+		lua_pushnil(L);
+		return 1; }
+	memcpy(&P, mem->prof, sizeof(zen_prof_t));
+	lua_createtable(L, 0, 4);
+	lua_pushinteger(L, P.live);
+	lua_setfield(L, -2, "live");
+	lua_pushinteger(L, P.peak);
+	lua_setfield(L, -2, "peak");
+	lua_createtable(L, 0, PROF_TYPES);
+	for(c=0; c<PROF_TYPES; c++) {
+		prof_push_stat(L, &P.type[c]);
+		lua_setfield(L, -2, prof_type_name[c]);
+	}
+	lua_setfield(L, -2, "types");
+	lua_createtable(L, PROF_BUCKETS, 0);
+	for(c=0; c<PROF_BUCKETS; c++) {
+		prof_push_stat(L, &P.bucket[c]);
+		if(c < PROF_BUCKETS-1) { // the last has no upper limit
+			lua_pushinteger(L, 16 << c);
+			lua_setfield(L, -2, "max"); }
+		lua_rawseti(L, -2, c+1);
+	}
+	lua_setfield(L, -2, "buckets");
+	return 1;
+}
+
+void zen_add_profile(lua_State *L) {
+	lua_register(L, "memory_profile", lua_memory_profile);
+}
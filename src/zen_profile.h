@@ -0,0 +1,37 @@
+#ifndef __ZEN_PROFILE_H__
+#define __ZEN_PROFILE_H__
+
+#include <lua.h>
+#include <zenroom.h>
+
+// allocation profiler for the Lua state, placed on top of the other
+// layers of zen_memory_manager(): every block carries a small header
+// with the type of object it was allocated for
+
+#define PROF_HDR 16 // keeps blocks aligned as the heap returns them
+#define PROF_TYPES 7 // other, string, table, function, userdata, thread, proto
+#define PROF_BUCKETS 16 // powers of two from 16 bytes to 256KiB, then bigger
+
+typedef struct {
+	unsigned long allocs;
+	unsigned long reallocs;
+	unsigned long frees;
+	size_t live; // bytes held by live blocks
+	size_t peak; // highest value of live
+	double time; // seconds spent in the allocator
+} zen_prof_stat_t;
+
+typedef struct {
+	zen_prof_stat_t type[PROF_TYPES];
+	zen_prof_stat_t bucket[PROF_BUCKETS];
+	size_t live;
+	size_t peak;
+} zen_prof_t;
+
+int   zen_prof_init(zen_mem_t *mem);
+void *zen_prof_manager(zen_mem_t *mem, void *ptr, size_t osize, size_t nsize);
+void  zen_prof_report(zen_mem_t *mem);
+void  zen_prof_teardown(zen_mem_t *mem);
+void  zen_add_profile(lua_State *L);
+
+#endif
@@ -0,0 +1,319 @@
+/*  Zenroom (DECODE project)
+ *
+ *  (c) Copyright 2017-2018 Dyne.org foundation
+ *  designed, written and maintained by Denis Roio <jaromil@dyne.org>
+ *
+ * This source code is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Public License as published
+ * by the Free Software Foundation; either version 3 of the License,
+ * or (at your option) any later version.
+ *
+ * This source code is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * Please refer to the GNU Public License for more details.
+ *
+ * You should have received a copy of the GNU Public License along with
+ * this source code; if not, write to:
+ * Free Software Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+
+
+// Random numbers for the whole process and for each context.
+//
+// zen_drbg() serves all random bytes taken by zenroom: a ChaCha20
+// generator with fast key erasure, seeded once from randombytes()
+// (the getrandom syscall on Linux). Each refill computes
+// DRBG_BLOCKS blocks of keystream under the current key: the first
+// 32 bytes become the next key and the others are handed out and
+// wiped as they go, so the state never holds anything that could
+// rebuild past output. The key is mixed with fresh system entropy
+// every DRBG_RESEED bytes and in a child process after fork(), which
+// would otherwise repeat the parent's numbers. Threads share it
+// under a lock.
+//
+// The csprng of a context is shared by all the keyrings created in
+// it: creating a keyring used to allocate its own csprng and read
+// 252 bytes from randombytes() every time, now it costs a pointer.
+// Its state is allocated outside the heap of the context, so that a
+// context restored from a snapshot (see zen_pool.c) keeps drawing new
+// numbers instead of repeating the ones after the snapshot. fork()
+// copies it as well: each seed records the fork generation of the
+// process and zen_random_draw() reseeds it when that changed, so
+// parent and child never share keys or signature nonces.
+//
+// With conf "seed=HEX" a context gets a generator of its own, the
+// same ChaCha20 keyed with the SHA256 of the seed and never reseeded:
+// all random numbers of the context come from it, so an execution
+// gives the same output every time. Pooled contexts restart it from
+// the seed after each execution.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+
+#if !defined(__EMSCRIPTEN__)
+#include <pthread.h>
+#endif
+
+#include <lua.h>
+
+#include <jutils.h>
+#include <zenroom.h>
+#include <zen_error.h>
+#include <zen_memory.h>
+#include <zen_random.h>
+#include <randombytes.h>
+
+static zen_drbg_t drbg;
+// incremented in the child on each fork()
+static volatile unsigned long drbg_forks = 0;
+
+#if !defined(__EMSCRIPTEN__)
+static pthread_mutex_t drbg_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_once_t drbg_once = PTHREAD_ONCE_INIT;
+
+static void drbg_atfork_child() {
+	drbg.seeded = 0;
+	drbg_forks++;
+	// the lock was held by the forking thread and is ours now
+	pthread_mutex_init(&drbg_lock, NULL);
+}
+static void drbg_atfork_prepare() { pthread_mutex_lock(&drbg_lock); }
+static void drbg_atfork_parent()  { pthread_mutex_unlock(&drbg_lock); }
+static void drbg_register() {
+	pthread_atfork(drbg_atfork_prepare, drbg_atfork_parent,
+	               drbg_atfork_child);
+}
+#endif
+
+#define ROTL32(v,n) (((v) << (n)) | ((v) >> (32 - (n))))
+#define QR(a,b,c,d)	  \
+	a += b; d ^= a; d = ROTL32(d,16); \
+	c += d; b ^= c; b = ROTL32(b,12); \
+	a += b; d ^= a; d = ROTL32(d, 8); \
+	c += d; b ^= c; b = ROTL32(b, 7)
+
+// one 64 bytes block of ChaCha20 keystream (RFC 7539)
+static void chacha20_block(unsigned char *out, const uint32_t key[8],
+                           uint32_t counter, const uint32_t nonce[3]) {
+	uint32_t in[16], x[16];
+	int i;
+	in[0] = 0x61707865; in[1] = 0x3320646e; // "expand 32-byte k"
+	in[2] = 0x79622d32; in[3] = 0x6b206574;
+	for(i=0; i<8; i++) in[4+i] = key[i];
+	in[12] = counter;
+	in[13] = nonce[0]; in[14] = nonce[1]; in[15] = nonce[2];
+	memcpy(x, in, sizeof(x));
+	for(i=0; i<10; i++) {
+		QR(x[0], x[4], x[ 8], x[12]);
+		QR(x[1], x[5], x[ 9], x[13]);
+		QR(x[2], x[6], x[10], x[14]);
+		QR(x[3], x[7], x[11], x[15]);
+		QR(x[0], x[5], x[10], x[15]);
+		QR(x[1], x[6], x[11], x[12]);
+		QR(x[2], x[7], x[ 8], x[13]);
+		QR(x[3], x[4], x[ 9], x[14]);
+	}
+	for(i=0; i<16; i++) {
+		uint32_t v = x[i] + in[i];
+		out[4*i]   =  v        & 0xff;
+		out[4*i+1] = (v >>  8) & 0xff;
+		out[4*i+2] = (v >> 16) & 0xff;
+		out[4*i+3] = (v >> 24) & 0xff;
+	}
+}
+
+static uint32_t le32(const unsigned char *p) {
+	return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static void drbg_refill(zen_drbg_t *D) {
+	static const uint32_t nonce[3] = { 0, 0, 0 };
+	int i;
+	for(i=0; i<DRBG_BLOCKS; i++)
+		chacha20_block(D->buf + 64*i, D->key, i, nonce);
+	for(i=0; i<8; i++)
+		D->key[i] = le32(D->buf + 4*i);
+	memset(D->buf, 0, 32);
+	D->pos = 32;
+}
+
+static void drbg_read(zen_drbg_t *D, void *buf, size_t len) {
+	unsigned char *out = (unsigned char*)buf;
+	size_t n;
+	while(len) {
+		if(D->pos == sizeof(D->buf)) drbg_refill(D);
+		n = sizeof(D->buf) - D->pos;
+		if(n > len) n = len;
+		memcpy(out, D->buf + D->pos, n);
+		memset(D->buf + D->pos, 0, n);
+		D->pos += n;
+		D->served += n;
+		out += n;
+		len -= n;
+	}
+}
+
+// keyed with 32 bytes, as they are
+static void drbg_start(zen_drbg_t *D, const char *key) {
+	int i;
+	for(i=0; i<8; i++)
+		D->key[i] = le32((const unsigned char*)key + 4*i);
+	drbg_refill(D);
+	D->served = 0;
+	D->seeded = 1;
+}
+
+// mixes 32 bytes of system entropy in the key
+static int drbg_reseed() {
+	unsigned char seed[32];
+	int i;
+	if(randombytes(seed, 32) != 0) {
+		error(NULL, "%s: no entropy from the system", __func__);
+		return 0; }
+	for(i=0; i<8; i++)
+		drbg.key[i] ^= le32(seed + 4*i);
+	memset(seed, 0, 32);
+	drbg_refill(&drbg);
+	drbg.served = 0;
+	drbg.seeded = 1;
+	drbg.reseeds++;
+	return 1;
+}
+
+unsigned long zen_random_forks() {
+#if !defined(__EMSCRIPTEN__)
+	// the handlers are registered before any context draws numbers
+	pthread_once(&drbg_once, drbg_register);
+#endif
+	return drbg_forks;
+}
+
+int zen_drbg(void *buf, size_t len) {
+	int res = 1;
+#if !defined(__EMSCRIPTEN__)
+	pthread_once(&drbg_once, drbg_register);
+	pthread_mutex_lock(&drbg_lock);
+#endif
+	if(!drbg.seeded || drbg.served >= DRBG_RESEED)
+		res = drbg_reseed();
+	if(res) drbg_read(&drbg, buf, len);
+#if !defined(__EMSCRIPTEN__)
+	pthread_mutex_unlock(&drbg_lock);
+#endif
+	return res;
+}
+
+// bytes from the generator of the context if it has one, else from
+// the one of the process
+static int random_read(zen_random_t *R, void *buf, size_t len) {
+	if(R && R->deterministic) {
+		drbg_read(&R->drbg, buf, len);
+		return 1; }
+	return zen_drbg(buf, len);
+}
+
+static int random_seed(zen_random_t *R) {
+	char tmp[ZEN_RANDOM_SEED];
+	if(!random_read(R, tmp, ZEN_RANDOM_SEED)) return 0;
+	RAND_seed(&R->rng, ZEN_RANDOM_SEED, tmp);
+	memset(tmp, 0, ZEN_RANDOM_SEED);
+	R->drawn = 0;
+	R->forks = zen_random_forks();
+	R->seeds++;
+	return 1;
+}
+
+static zen_random_t *random_new(zenroom_t *Z) {
+	zen_random_t *R = system_alloc(sizeof(zen_random_t));
+	if(!R) {
+		error(NULL, "%s: cannot allocate random generator", __func__);
+		return NULL; }
+	R->seeds = 0;
+	R->deterministic = 0;
+	Z->random = R;
+	return R;
+}
+
+static zenroom_t *random_ctx(lua_State *L) {
+	zenroom_t *Z;
+	lua_getglobal(L, "_Z");
+	Z = lua_touserdata(L, -1);
+	lua_pop(L, 1);
+	SAFE(Z);
+	return Z;
+}
+
+int zen_random_bytes(lua_State *L, void *buf, size_t len) {
+	zenroom_t *Z = random_ctx(L);
+	if(!Z) return 0;
+	return random_read((zen_random_t*)Z->random, buf, len);
+}
+
+// the generator of the context, created and seeded on first use
+static zen_random_t *random_get(lua_State *L) {
+	zenroom_t *Z = random_ctx(L);
+	zen_random_t *R;
+	if(!Z) return NULL;
+	R = (zen_random_t*)Z->random;
+	if(R) return R;
+	if(!(R = random_new(Z))) return NULL;
+	if(!random_seed(R)) {
+		zen_random_teardown(Z);
+		return NULL; }
+	return R;
+}
+
+csprng *zen_random(lua_State *L) {
+	zen_random_t *R = random_get(L);
+	return R ? &R->rng : NULL;
+}
+
+csprng *zen_random_draw(lua_State *L, size_t len) {
+	zen_random_t *R = random_get(L);
+	if(!R) return NULL;
+	if(R->drawn >= ZEN_RANDOM_RESEED) {
+		func(L, "%s: reseed after %lu bytes", __func__,
+		     (unsigned long)R->drawn);
+		if(!random_seed(R)) return NULL;
+	} else if(!R->deterministic && R->forks != zen_random_forks()) {
+		func(L, "%s: reseed in child process", __func__);
+		if(!random_seed(R)) return NULL;
+	}
+	R->drawn += len;
+	return &R->rng;
+}
+
+int zen_random_seed(zenroom_t *Z, const char *seed, int len) {
+	zen_random_t *R;
+	hash256 sha;
+	int i;
+	if(!(R = random_new(Z))) return 0;
+	HASH256_init(&sha);
+	for(i=0; i<len; i++) HASH256_process(&sha, (unsigned char)seed[i]);
+	HASH256_hash(&sha, R->seed);
+	R->deterministic = 1;
+	act(NULL, "Deterministic random numbers from a seed of %d bytes", len);
+	zen_random_reset(Z);
+	return 1;
+}
+
+void zen_random_reset(zenroom_t *Z) {
+	zen_random_t *R = (zen_random_t*)Z->random;
+	if(!R || !R->deterministic) return;
+	drbg_start(&R->drbg, R->seed);
+	R->seeds = 0;
+	random_seed(R);
+}
+
+void zen_random_teardown(zenroom_t *Z) {
+	zen_random_t *R = (zen_random_t*)Z->random;
+	if(!R) return;
+	func(NULL, "random generator seeded %lu times", R->seeds);
+	RAND_clean(&R->rng);
+	memset(R, 0, sizeof(zen_random_t));
+	system_free(R);
+	Z->random = NULL;
+}
@@ -0,0 +1,58 @@
+#ifndef __ZEN_RANDOM_H__
+#define __ZEN_RANDOM_H__
+
+#include <amcl.h>
+#include <lua.h>
+#include <zenroom.h>
+
+#include <stdint.h>
+
+// ChaCha20 generator, see zen_random.c
+#define DRBG_BLOCKS 16 // 1KiB of keystream for each refill
+#define DRBG_RESEED (1<<20) // bytes served between reseeds
+
+typedef struct {
+	uint32_t key[8];
+	unsigned char buf[64*DRBG_BLOCKS];
+	size_t pos; // first unused byte of buf
+	size_t served; // bytes since the last reseed
+	int seeded; // cleared in the child after fork()
+	unsigned long reseeds;
+} zen_drbg_t;
+
+// fills buf with len random bytes from the process wide generator,
+// returns 0 if the system gives no entropy to seed it
+int zen_drbg(void *buf, size_t len);
+// number of fork() calls which led to this process
+unsigned long zen_random_forks();
+
+// random generator shared by all keyrings of a context, seeded from
+// zen_drbg() on first use and again once ZEN_RANDOM_RESEED bytes are
+// drawn from it, or in a child process after fork()
+
+#define ZEN_RANDOM_SEED   256 // bytes of seed
+#define ZEN_RANDOM_RESEED (1<<16) // bytes drawn between reseeds
+
+typedef struct {
+	csprng rng;
+	size_t drawn; // bytes drawn since the last seed
+	unsigned long forks; // zen_random_forks() when seeded
+	unsigned long seeds;
+	int deterministic; // conf "seed=HEX", numbers come from drbg
+	char seed[32]; // SHA256 of the seed, to restart drbg
+	zen_drbg_t drbg;
+} zen_random_t;
+
+csprng *zen_random(lua_State *L);
+// the generator of the context for drawing about len bytes from it,
+// reseeded first when due
+csprng *zen_random_draw(lua_State *L, size_t len);
+// random bytes for the context of L
+int     zen_random_bytes(lua_State *L, void *buf, size_t len);
+// deterministic mode, all random numbers of the context from seed
+int     zen_random_seed(zenroom_t *Z, const char *seed, int len);
+// restart from the seed in deterministic mode, else nothing
+void    zen_random_reset(zenroom_t *Z);
+void    zen_random_teardown(zenroom_t *Z);
+
+#endif
@@ -0,0 +1,227 @@
+/*  Zenroom (DECODE project)
+ *
+ *  (c) Copyright 2017-2018 Dyne.org foundation
+ *  designed, written and maintained by Denis Roio <jaromil@dyne.org>
+ *
+ * This source code is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Public License as published
+ * by the Free Software Foundation; either version 3 of the License,
+ * or (at your option) any later version.
+ *
+ * This source code is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * Please refer to the GNU Public License for more details.
+ *
+ * You should have received a copy of the GNU Public License along with
+ * this source code; if not, write to:
+ * Free Software Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+
+// Size-class slab allocator for the small objects allocated by Lua
+// (strings, closures, table nodes, upvalues) selected with conf
+// "slab". Blocks up to SLAB_MAX bytes are carved from pages taken from
+// the heap and recycled through one free list per class, so most
+// allocations and frees cost a pointer swap instead of a walk of the
+// umm free list.
+//
+// Blocks have no header: Lua always tells the size of the block it
+// frees or reallocates (osize), which is enough to find its class. A
+// block can be bigger than its class says (when a block shrinks it
+// is kept in place) but never smaller, so it is always safe to
+// recycle it in the class of its last known size.
+//
+// A heap block that cannot be moved into a page when it shrinks is
+// adopted by the slab: its bytes past SLAB_MAX, which no class ever
+// uses, link it in a list so that teardown gives it back to the heap.
+// Heap blocks are never smaller than SLAB_HEAP_MIN to leave room for
+// the link.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <jutils.h>
+#include <zenroom.h>
+#include <zen_slab.h>
+
+// each page starts with a pointer to the next one, keeping blocks
+// aligned to 16 bytes
+#define SLAB_PAGE_HDR 16
+
+#define SLAB_HEAP_MIN (SLAB_MAX + sizeof(void*))
+#define SLAB_HEAP(size) ((size) < SLAB_HEAP_MIN ? SLAB_HEAP_MIN : (size))
+#define SLAB_LINK(ptr) (*(void**)((char*)(ptr) + SLAB_MAX))
+
+static const unsigned short slab_size[SLAB_CLASSES] = {
+	  8,  16,  24,  32,  40,  48,  56,  64,
+	 72,  80,  88,  96, 104, 112, 120, 128,
+	144, 160, 176, 192, 208, 224, 240, 256 };
+
+static inline int slab_class(size_t size) {
+	if(size <= 128) return (size + 7) / 8 - 1;
+	return 15 + (size - 128 + 15) / 16;
+}
+
+// the slab state lives in the heap, so it is part of heap snapshots
+int zen_slab_init(zen_mem_t *mem) {
+	zen_slab_t *S = (*mem->malloc)(mem->heap, sizeof(zen_slab_t));
+	if(!S) {
+		error(NULL, "%s: cannot allocate slab", __func__);
+		return 0; }
+	memset(S, 0, sizeof(zen_slab_t));
+	mem->slab = S;
+	act(NULL, "SLAB allocator for blocks up to %u bytes", SLAB_MAX);
+	return 1;
+}
+
+static void *slab_alloc(zen_mem_t *mem, zen_slab_t *S, size_t size) {
+	int c = slab_class(size);
+	zen_slab_class_t *st = &S->stats[c];
+	void *ret = S->free[c];
+	if(ret) {
+		S->free[c] = *(void**)ret;
+		st->hits++;
+	} else if(S->bump[c] && S->bump[c] + slab_size[c] <= S->bump_end[c]) {
+		ret = S->bump[c];
+		S->bump[c] += slab_size[c];
+	} else {
+		char *page = (*mem->malloc)(mem->heap, SLAB_PAGE);
+		if(page) {
+			*(void**)page = S->pages;
+			S->pages = page;
+			S->npages++;
+			S->misses++;
+			ret = page + SLAB_PAGE_HDR;
+			S->bump[c] = page + SLAB_PAGE_HDR + slab_size[c];
+			S->bump_end[c] = page + SLAB_PAGE;
+		} else {
+			// heap is full: use a free block of a bigger class
+			int b;
+			for(b=c+1; b<SLAB_CLASSES; b++)
+				if(S->free[b]) break;
+			if(b == SLAB_CLASSES) return NULL;
+			ret = S->free[b];
+			S->free[b] = *(void**)ret;
+			st->hits++;
+		}
+	}
+	st->allocs++;
+	st->live += slab_size[c];
+	st->requested += size;
+	return ret;
+}
+
+static void slab_free(zen_slab_t *S, void *ptr, size_t size) {
+	int c = slab_class(size);
+	zen_slab_class_t *st = &S->stats[c];
+	*(void**)ptr = S->free[c];
+	S->free[c] = ptr;
+	st->frees++;
+	st->live -= slab_size[c];
+	st->requested -= size;
+}
+
+// same arguments as zen_memory_manager(), see lua_Alloc
+void *zen_slab_manager(zen_mem_t *mem, void *ptr, size_t osize, size_t nsize) {
+	zen_slab_t *S = (zen_slab_t*)mem->slab;
+	void *ret;
+	if(!ptr) { // osize is the type of object, not a size
+		if(!nsize) return NULL;
+		if(nsize <= SLAB_MAX) return slab_alloc(mem, S, nsize);
+		return (*mem->malloc)(mem->heap, SLAB_HEAP(nsize));
+	}
+
+	if(!nsize) {
+		if(osize <= SLAB_MAX) slab_free(S, ptr, osize);
+		else (*mem->free)(mem->heap, ptr);
+		return NULL;
+	}
+
+	if(osize > SLAB_MAX && nsize > SLAB_MAX)
+		return (*mem->realloc)(mem->heap, ptr, SLAB_HEAP(nsize));
+
+	if(nsize <= osize) { // shrink, must not fail
+		if(osize > SLAB_MAX) {
+			ret = slab_alloc(mem, S, nsize);
+			if(ret) {
+				memcpy(ret, ptr, nsize);
+				(*mem->free)(mem->heap, ptr);
+				return ret; }
+			// out of memory: the heap block joins the slab in place
+			SLAB_LINK(ptr) = S->heap_blocks;
+			S->heap_blocks = ptr;
+			S->adopted++;
+			S->stats[slab_class(nsize)].live += slab_size[slab_class(nsize)];
+			S->stats[slab_class(nsize)].requested += nsize;
+			return ptr;
+		}
+		// block stays, accounted in the class of the new size
+		S->stats[slab_class(osize)].live -= slab_size[slab_class(osize)];
+		S->stats[slab_class(osize)].requested -= osize;
+		S->stats[slab_class(nsize)].live += slab_size[slab_class(nsize)];
+		S->stats[slab_class(nsize)].requested += nsize;
+		return ptr;
+	}
+
+	// grow a slab block
+	if(nsize <= SLAB_MAX && slab_class(nsize) == slab_class(osize)) {
+		S->stats[slab_class(osize)].requested += nsize - osize;
+		return ptr; }
+	ret = (nsize <= SLAB_MAX) ?
+		slab_alloc(mem, S, nsize) : (*mem->malloc)(mem->heap, SLAB_HEAP(nsize));
+	if(!ret) return NULL;
+	memcpy(ret, ptr, osize);
+	slab_free(S, ptr, osize);
+	return ret;
+}
+
+void zen_slab_report(zen_mem_t *mem) {
+	zen_slab_t *S = (zen_slab_t*)mem->slab;
+	unsigned long allocs = 0, hits = 0;
+	size_t live = 0, requested = 0, freed = 0;
+	size_t pages = S->npages * (SLAB_PAGE - SLAB_PAGE_HDR);
+	int c;
+	for(c=0; c<SLAB_CLASSES; c++) {
+		zen_slab_class_t *st = &S->stats[c];
+		size_t nfree = 0;
+		void *p;
+		for(p = S->free[c]; p; p = *(void**)p) nfree++;
+		allocs += st->allocs;
+		hits += st->hits;
+		live += st->live;
+		requested += st->requested;
+		freed += nfree * slab_size[c];
+		if(st->allocs)
+			func(NULL, "SLAB class %3u: %6lu allocs %6lu hits %6u B live %4u free",
+			     slab_size[c], st->allocs, st->hits, st->live, nfree);
+	}
+	act(NULL, "SLAB %lu pages (%u KiB), %lu allocations, free list hit rate %.1f%%",
+	    S->npages, (S->npages * SLAB_PAGE)/1024, allocs,
+	    allocs ? (100.0 * hits) / allocs : 0.0);
+	act(NULL, "SLAB live %u B for %u B requested (%.1f%% internal fragmentation), %u B in free lists (%.1f%% of pages)",
+	    live, requested,
+	    live ? (100.0 * (live - requested)) / live : 0.0,
+	    freed, pages ? (100.0 * freed) / pages : 0.0);
+	if(S->adopted)
+		act(NULL, "SLAB %lu heap blocks adopted on shrink", S->adopted);
+}
+
+// to be called after lua_close, when no block is in use anymore
+void zen_slab_teardown(zen_mem_t *mem) {
+	zen_slab_t *S = (zen_slab_t*)mem->slab;
+	void *page = S->pages;
+	void *block = S->heap_blocks;
+	while(page) {
+		void *next = *(void**)page;
+		(*mem->free)(mem->heap, page);
+		page = next;
+	}
+	while(block) {
+		void *next = SLAB_LINK(block);
+		(*mem->free)(mem->heap, block);
+		block = next;
+	}
+	(*mem->free)(mem->heap, S);
+	mem->slab = NULL;
+}
@@ -0,0 +1,38 @@
+#ifndef __ZEN_SLAB_H__
+#define __ZEN_SLAB_H__
+
+#include <zenroom.h>
+
+// segregated size-class allocator for the small objects of Lua, placed
+// between zen_memory_manager() and the heap (umm or libc)
+
+#define SLAB_MAX  256  // largest block served, bigger go to the heap
+#define SLAB_PAGE 2048 // size of pages taken from the heap
+#define SLAB_CLASSES 24 // 8 bytes steps up to 128, then 16 up to 256
+
+typedef struct {
+	unsigned long allocs; // requests served
+	unsigned long hits; // served from the free list
+	unsigned long frees;
+	size_t live; // bytes held by live blocks
+	size_t requested; // bytes requested for live blocks
+} zen_slab_class_t;
+
+typedef struct {
+	void *free[SLAB_CLASSES]; // free lists
+	char *bump[SLAB_CLASSES]; // unused part of the last page of a class
+	char *bump_end[SLAB_CLASSES];
+	void *pages; // list of pages taken from the heap
+	unsigned long npages;
+	unsigned long adopted; // heap blocks shrunk into a class
+	void *heap_blocks; // list of the adopted heap blocks
+	unsigned long misses; // pages requested
+	zen_slab_class_t stats[SLAB_CLASSES];
+} zen_slab_t;
+
+int   zen_slab_init(zen_mem_t *mem);
+void *zen_slab_manager(zen_mem_t *mem, void *ptr, size_t osize, size_t nsize);
+void  zen_slab_report(zen_mem_t *mem);
+void  zen_slab_teardown(zen_mem_t *mem);
+
+#endif
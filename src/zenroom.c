@@ -40,6 +40,11 @@
 
 #include <zenroom.h>
 #include <zen_memory.h>
+#include <zen_slab.h>
+#include <zen_profile.h>
+#include <zen_arena.h>
+#include <zen_random.h>
+#include <zen_codec.h>
 
 // prototypes from lua_modules.c
 extern int zen_require_override(lua_State *L, const int restricted);
@@ -50,10 +55,15 @@ extern void zen_add_io(lua_State *L);
 
 // prototypes from zen_memory.c
 extern zen_mem_t *libc_memory_init();
-extern zen_mem_t *umm_memory_init(size_t size);
+extern zen_mem_t *umm_memory_init(size_t size, size_t max);
+extern void zen_memory_activate(zen_mem_t *mem);
+extern void *zen_memory_snapshot(zen_mem_t *mem);
+extern size_t zen_memory_snapshot_size(void *img);
+extern void zen_memory_restore(zen_mem_t *mem, void *img);
 extern void *zen_memory_manager(void *ud, void *ptr, size_t osize, size_t nsize);
-extern void *umm_info(void*);
-extern int umm_integrity_check();
+extern void *umm_info(void *heap, void *ptr);
+extern int umm_integrity_check(void *heap);
+extern void umm_release(void *heap);
 
 // prototypes from lua_functions.c
 extern void load_file(char *dst, FILE *fd);
@@ -67,16 +77,71 @@ zenroom_t *ast_init(char *script);
 int  ast_parse(zenroom_t *Z);
 void ast_teardown(zenroom_t *Z);
 
+// parses sizes like 65536, 512K or 4M
+static size_t conf_size(const char *val) {
+	char *end;
+	unsigned long long size = strtoull(val, &end, 10);
+	switch(*end) {
+	case 'k': case 'K': size <<= 10; end++; break;
+	case 'm': case 'M': size <<= 20; end++; break;
+	case 'g': case 'G': size <<= 30; end++; break;
+	}
+	if(end == val || *end) return 0;
+	return (size_t)size;
+}
+
+int zen_conf_parse(zen_conf_t *zconf, const char *conf) {
+	char buf[MAX_STRING];
+	char *tok, *save = NULL;
+	memset(zconf, 0, sizeof(zen_conf_t));
+	if(!conf) return 1;
+	snprintf(buf, MAX_STRING, "%s", conf);
+	for(tok = strtok_r(buf, ", ", &save); tok;
+	    tok = strtok_r(NULL, ", ", &save)) {
+		if(strcasecmp(tok, "umm")==0)
+			zconf->umm = 1;
+		else if(strcasecmp(tok, "slab")==0)
+			zconf->slab = 1;
+		else if(strcasecmp(tok, "profile")==0)
+			zconf->profile = 1;
+		else if(strcasecmp(tok, "arena")==0)
+			zconf->arena = 1;
+		else if(strncasecmp(tok, "heap=", 5)==0) {
+			zconf->heap = conf_size(tok+5);
+			if(!zconf->heap) {
+				error(NULL, "%s: invalid heap size: %s", __func__, tok+5);
+				return 0; }
+			zconf->umm = 1;
+		} else if(strncasecmp(tok, "seed=", 5)==0) {
+			long len = zen_hex_decode((unsigned char*)zconf->seed,
+			                          ZEN_SEED_MAX, tok+5, strlen(tok+5));
+			if(len <= 0) {
+				error(NULL, "%s: invalid seed (max %d bytes in hex): %s",
+				      __func__, ZEN_SEED_MAX, tok+5);
+				return 0; }
+			zconf->seedlen = (int)len;
+		} else
+			func(NULL, "%s: ignored unknown option: %s", __func__, tok);
+	}
+	return 1;
+}
+
 zenroom_t *zen_init(const char *conf,
                     char *keys, char *data) {
-	(void) conf;
 	lua_State *L = NULL;
 	zen_mem_t *mem = NULL;
-	if(conf) {
-		if(strcasecmp(conf,"umm")==0)
-			mem = umm_memory_init(UMM_HEAP); // (64KiB)
-	} else
+	zen_conf_t zconf;
+	if(!zen_conf_parse(&zconf, conf)) return NULL;
+	if(zconf.umm) // 64KiB, or growing up to zconf.heap
+		mem = umm_memory_init(UMM_HEAP, zconf.heap);
+	else
 		mem = libc_memory_init();
+	if(zconf.slab)
+		zen_slab_init(mem);
+	if(zconf.profile)
+		zen_prof_init(mem);
+	if(zconf.arena)
+		zen_arena_init(mem);
 
 	L = lua_newstate(zen_memory_manager, mem);
 	if(!L) {
@@ -94,11 +159,19 @@ zenroom_t *zen_init(const char *conf,
 	Z->stderr_buf = NULL;
 	Z->stderr_pos = 0;
 	Z->stderr_len = 0;
+	Z->snapshot = NULL;
+	Z->random = NULL;
 	Z->userdata = NULL;
 	//Set zenroom context as a global in lua
 	//this will be freed on lua_close
 	lua_pushlightuserdata(L, Z);
 	lua_setglobal(L, "_Z");
+	if(zconf.seedlen) {
+		int res = zen_random_seed(Z, zconf.seed, zconf.seedlen);
+		memset(zconf.seed, 0, ZEN_SEED_MAX);
+		if(!res) {
+			zen_teardown(Z);
+			return NULL; } }
 
 	// initialise global variables
 #if defined(VERSION)
@@ -115,9 +188,11 @@ zenroom_t *zen_init(const char *conf,
 	luaL_openlibs(L);
 	// load our own openlibs and extensions
 	zen_add_io(L);
+	zen_add_profile(L);
 	zen_require_override(L,0);
 	if(!zen_lua_init(L)) {
 		error(L,"%s: %s", __func__, "initialisation of lua scripts failed");
+		zen_teardown(Z);
 		return NULL;
 	}
 	//////////////////// end of create
@@ -143,10 +218,17 @@ zenroom_t *zen_init(const char *conf,
 void zen_teardown(zenroom_t *Z) {
 
 	notice(Z->lua,"Zenroom teardown.");
+	zen_memory_activate(Z->mem);
     if(Z->mem->heap) {
-	    if(umm_integrity_check())
+	    if(umm_integrity_check(Z->mem->heap))
 		    func(Z->lua,"HEAP integrity checks passed.");
-	    umm_info(Z->mem->heap); }
+	    umm_info(Z->mem->heap, NULL); }
+    if(Z->mem->slab)
+	    zen_slab_report(Z->mem);
+    if(Z->mem->prof)
+	    zen_prof_report(Z->mem);
+    if(Z->mem->arena)
+	    zen_arena_report(Z->mem);
     // save pointers inside Z to free after L and Z
     void *mem = Z->mem;
     void *heap = Z->mem->heap;
@@ -157,14 +239,53 @@ void zen_teardown(zenroom_t *Z) {
 	    // this call here frees also Z (lightuserdata)
 	    lua_close((lua_State*)Z->lua);
     }
+    if(Z->mem->arena)
+	    zen_arena_teardown(Z->mem);
+    if(Z->mem->prof)
+	    zen_prof_teardown(Z->mem);
+    if(Z->mem->slab)
+	    zen_slab_teardown(Z->mem);
     func(NULL,"zen free");
-    if(heap)
-	    system_free(heap);
-    free(Z);
+    if(heap) {
+	    umm_release(heap);
+	    system_free(heap); }
+    if(Z->snapshot)
+	    system_free(Z->snapshot);
+    zen_random_teardown(Z);
+    system_free(Z);
     if(mem) system_free(mem);
     func(NULL,"teardown completed");
 }
 
+int zen_snapshot(zenroom_t *Z) {
+	if(!Z->mem->heap) {
+		error(Z->lua, "%s: snapshot needs the umm memory manager", __func__);
+		return 0; }
+	double start = dtime();
+	zen_memory_activate(Z->mem);
+	lua_gc((lua_State*)Z->lua, LUA_GCCOLLECT, 0);
+	if(Z->snapshot) system_free(Z->snapshot);
+	Z->snapshot = zen_memory_snapshot(Z->mem);
+	if(!Z->snapshot) return 0;
+	func(Z->lua, "HEAP snapshot of %u KiB saved in %.3f ms",
+	     zen_memory_snapshot_size(Z->snapshot)/1024, (dtime()-start)*1000);
+	return 1;
+}
+
+int zen_restore(zenroom_t *Z) {
+	if(!Z->snapshot) {
+		error(Z->lua, "%s: no snapshot saved", __func__);
+		return 0; }
+	zen_memory_activate(Z->mem);
+	zen_memory_restore(Z->mem, Z->snapshot);
+	Z->stdout_buf = NULL;
+	Z->stdout_pos = 0;
+	Z->stdout_len = 0;
+	Z->stderr_buf = NULL;
+	Z->stderr_pos = 0;
+	Z->stderr_len = 0;
+	return 1;
+}
 
 int zen_exec_script(zenroom_t *Z, const char *script) {
 	if(!Z) {
@@ -182,9 +303,14 @@ int zen_exec_script(zenroom_t *Z, const char *script) {
 	if(ret) {
 		error(L, "%s", lua_tostring(L, -1));
 		fflush(stderr);
-		return ret;
 	}
-	return 0;
+	if(Z->mem->arena) {
+		// collect the temporary octets, then move the surviving
+		// ones out of the arena before emptying it
+		lua_gc(L, LUA_GCCOLLECT, 0);
+		zen_arena_reset(Z->mem);
+	}
+	return ret;
 }
 
 int zenroom_exec(char *script, char *conf, char *keys,
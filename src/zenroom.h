@@ -35,6 +35,45 @@ int zenroom_exec_tobuf(char *script, char *conf, char *keys,
                        char *stdout_buf, size_t stdout_len,
                        char *stderr_buf, size_t stderr_len);
 
+// same as zenroom_exec_tobuf, but runs inside a pre-initialised
+// context taken from a pool (see zen_pool_init below) which is reset
+// and given back to the pool when execution completes.
+struct zen_pool_t;
+int zenroom_pool_exec_tobuf(struct zen_pool_t *pool, char *script,
+                            char *keys, char *data,
+                            char *stdout_buf, size_t stdout_len,
+                            char *stderr_buf, size_t stderr_len);
+
+// many scripts executed at once on a pool of threads, each with its
+// own context: per-job results are written into the job, the return
+// value is the number of failed jobs and stats (if not NULL) reports
+// the throughput. nthreads <= 0 uses one thread per online CPU.
+typedef struct {
+	char *script;
+	char *keys;
+	char *data;
+	char *stdout_buf;
+	size_t stdout_len;
+	char *stderr_buf;
+	size_t stderr_len;
+
+	int return_code; // set on completion, 1 if never executed
+	double time; // seconds spent executing
+} zen_job_t;
+
+typedef struct {
+	int jobs;
+	int failed;
+	int threads;
+	unsigned long stolen; // jobs executed by a thread other than the assigned one
+	double elapsed; // seconds
+	double throughput; // jobs per second
+} zen_batch_stats_t;
+
+int zenroom_exec_batch(zen_job_t *jobs, int njobs, char *conf,
+                       int nthreads, int verbosity,
+                       zen_batch_stats_t *stats);
+
 // to obtain the Abstract Syntax Tree (AST) of a script
 // (output is in metalua formatted as JSON)
 int zenroom_parse_ast(char *script, int verbosity,
@@ -46,18 +85,38 @@ int zenroom_parse_ast(char *script, int verbosity,
 
 // lower level api: init (exec_line*) teardown
 
-// heap initialised by the memory manager
+// heap initialised by the memory manager, each context has its own
+// and the heap is passed as first argument to the allocator
 typedef struct {
-	void* (*malloc)(size_t size);
-	void* (*realloc)(void *ptr, size_t size);
-	void  (*free)(void *ptr);
+	void* (*malloc)(void *heap, size_t size);
+	void* (*realloc)(void *heap, void *ptr, size_t size);
+	void  (*free)(void *heap, void *ptr);
 	void* (*sys_malloc)(size_t size);
 	void* (*sys_realloc)(void *ptr, size_t size);
 	void  (*sys_free)(void *ptr);
 	char  *heap;
 	size_t heap_size;
+	void  *slab; // size-class layer for small Lua objects (zen_slab.h)
+	void  *prof; // allocation profiler (zen_profile.h)
+	void  *arena; // bump allocator for octets (zen_arena.h)
 } zen_mem_t;
 
+#define ZEN_SEED_MAX 64 // bytes
+
+// options parsed from the conf string of zen_init(), which is a
+// comma separated list of keywords and key=value settings
+typedef struct {
+	int umm; // "umm": sandboxed umm heap instead of libc malloc
+	int slab; // "slab": size-class slab allocator for small objects
+	size_t heap; // "heap=SIZE": umm heap growing up to SIZE bytes (K,M,G suffix)
+	int profile; // "profile": allocation profile by Lua type and size
+	int arena; // "arena": octets allocated in bulk, freed after each execution
+	char seed[ZEN_SEED_MAX]; // "seed=HEX": deterministic random numbers
+	int seedlen;
+} zen_conf_t;
+
+int zen_conf_parse(zen_conf_t *zconf, const char *conf);
+
 // zenroom context, also available as "_Z" global in lua space
 // contents are opaque in lua and available only as lightuserdata
 typedef struct {
@@ -71,6 +130,9 @@ typedef struct {
 	size_t stderr_len;
 	size_t stderr_pos;
 
+	void *snapshot; // image of the heap saved by zen_snapshot
+	void *random; // random generator shared by keyrings (zen_random.h)
+
 	void *userdata; // anything passed at init (reserved for caller)
 } zenroom_t;
 
@@ -79,6 +141,39 @@ zenroom_t *zen_init(const char *conf, char *keys, char *data);
 int  zen_exec_script(zenroom_t *Z, const char *script);
 void zen_teardown(zenroom_t *zenroom);
 
+// reusable pool of contexts: zen_init is paid once per context at
+// pool creation, then each execution acquires a context and releases
+// it, which restores its globals and modules to the post-init state.
+typedef struct zen_pool_t {
+	zenroom_t **ctx;
+	char *busy;
+	double *lat; // acquire latency of each busy context
+	int size;
+
+	double target; // max acquire+release latency (seconds)
+	unsigned long calls;
+	unsigned long over_target;
+	double total_lat;
+	double peak_lat;
+} zen_pool_t;
+
+// latency target for acquire+release of a pooled context
+#define ZEN_POOL_TARGET 0.001 // 1ms
+
+zen_pool_t *zen_pool_init(const char *conf, int size);
+zenroom_t  *zen_pool_acquire(zen_pool_t *pool, char *keys, char *data);
+void        zen_pool_release(zen_pool_t *pool, zenroom_t *Z);
+void        zen_pool_teardown(zen_pool_t *pool);
+
+// save the current state of globals as the one restored by zen_reset
+int zen_pristine(zenroom_t *Z);
+int zen_reset(zenroom_t *Z);
+
+// save an image of the whole umm heap and copy it back in place,
+// taking the context back to that exact state (only with conf "umm")
+int zen_snapshot(zenroom_t *Z);
+int zen_restore(zenroom_t *Z);
+
 #define UMM_HEAP (64*1024) // 64KiB (masked with 0x7fff)
 #define MAX_FILE (64*512) // load max 32KiB files
 #define MAX_STRING 4097 // max 4KiB strings
@@ -86,6 +181,14 @@ void zen_teardown(zenroom_t *zenroom);
 
 #define LUA_BASELIBNAME "_G"
 
+// thread local storage, for state which is per-context but has no
+// context pointer at hand (current memory manager, message buffers)
+#if defined(_MSC_VER)
+#define ZEN_TLS __declspec(thread)
+#else
+#define ZEN_TLS __thread
+#endif
+
 #define ZEN_BITS 8
 #ifndef SIZE_MAX
 #if ZEN_BITS == 32
@@ -0,0 +1,123 @@
+/*  Zenroom (DECODE project)
+ *
+ *  (c) Copyright 2017-2018 Dyne.org foundation
+ *  designed, written and maintained by Denis Roio <jaromil@dyne.org>
+ *
+ * This source code is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Public License as published
+ * by the Free Software Foundation; either version 3 of the License,
+ * or (at your option) any later version.
+ *
+ * This source code is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * Please refer to the GNU Public License for more details.
+ *
+ * You should have received a copy of the GNU Public License along with
+ * this source code; if not, write to:
+ * Free Software Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+
+// Checks zenroom_exec_batch on a few hundred jobs of uneven size run
+// by several threads: each job must report its own output and return
+// code, whichever thread ran it and whatever ran before on its
+// context.
+//
+// build and run with: make batch
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <jutils.h>
+#include <zenroom.h>
+
+#define NJOBS 300
+#define NTHREADS 4
+#define OUTMAX 256
+#define ERRMAX 4096
+
+static zen_job_t jobs[NJOBS];
+static char script[NJOBS][OUTMAX];
+static char data[NJOBS][32];
+static char out[NJOBS][OUTMAX];
+static char err[NJOBS][ERRMAX];
+
+// every 50th job fails
+#define JOB_FAILS(i) ((i) % 50 == 7)
+// a few slow jobs among many quick ones
+#define JOB_SIZE(i) ((i) % 37 == 0 ? 200000 : (i) * 10 + 1)
+
+static int fail(const char *conf, const char *msg, int job) {
+	fprintf(stderr, "batch (conf %s): job %i: %s\n",
+	        conf ? conf : "none", job, msg);
+	return 0;
+}
+
+// scripts fail if they find the global left by a previous job, print
+// adds no newline when writing to a buffer
+static void batch_setup() {
+	int i;
+	for(i=0; i<NJOBS; i++) {
+		if(JOB_FAILS(i))
+			snprintf(script[i], OUTMAX, "assert(false, 'job %i fails')", i);
+		else
+			snprintf(script[i], OUTMAX,
+			         "assert(not LEFTOVER) LEFTOVER = true\n"
+			         "local s = 0 for i=1,%i do s = s + i end\n"
+			         "print(DATA .. ' ' .. s .. '\\n')", JOB_SIZE(i));
+		snprintf(data[i], sizeof(data[i]), "job %i", i);
+		memset(out[i], 0, OUTMAX);
+		memset(err[i], 0, ERRMAX);
+		jobs[i].script = script[i];
+		jobs[i].keys = NULL;
+		jobs[i].data = data[i];
+		jobs[i].stdout_buf = out[i];
+		jobs[i].stdout_len = OUTMAX - 1;
+		jobs[i].stderr_buf = err[i];
+		jobs[i].stderr_len = ERRMAX - 1;
+	}
+}
+
+static int batch_check(const char *conf) {
+	zen_batch_stats_t stats;
+	char expect[OUTMAX];
+	long long n;
+	int i, failed, expect_failed = 0;
+	printf("== %i jobs on %i threads (conf %s)\n",
+	       NJOBS, NTHREADS, conf ? conf : "none");
+	batch_setup();
+	failed = zenroom_exec_batch(jobs, NJOBS, (char*)conf, NTHREADS, 1, &stats);
+	for(i=0; i<NJOBS; i++) {
+		if(JOB_FAILS(i)) {
+			expect_failed++;
+			if(jobs[i].return_code != 1)
+				return fail(conf, "failing job reported success", i);
+			if(out[i][0])
+				return fail(conf, "failing job printed output", i);
+			continue; }
+		if(jobs[i].return_code) {
+			fprintf(stderr, "%s\n", err[i]);
+			return fail(conf, "job failed", i); }
+		n = JOB_SIZE(i);
+		snprintf(expect, OUTMAX, "job %i %lld\n", i, n * (n + 1) / 2);
+		if(strcmp(out[i], expect))
+			return fail(conf, "unexpected output", i);
+	}
+	if(failed != expect_failed || stats.failed != expect_failed)
+		return fail(conf, "wrong count of failed jobs", -1);
+	if(stats.jobs != NJOBS || stats.threads != NTHREADS)
+		return fail(conf, "wrong batch statistics", -1);
+	return 1;
+}
+
+int main() {
+	set_debug(1);
+
+	printf("= test batch execution of jobs on threads\n");
+	if(!batch_check(NULL)) return 1;
+	if(!batch_check("umm,heap=4M")) return 1;
+
+	printf("= OK\n");
+	return 0;
+}
@@ -0,0 +1,131 @@
+/*  Zenroom (DECODE project)
+ *
+ *  (c) Copyright 2017-2018 Dyne.org foundation
+ *  designed, written and maintained by Denis Roio <jaromil@dyne.org>
+ *
+ * This source code is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Public License as published
+ * by the Free Software Foundation; either version 3 of the License,
+ * or (at your option) any later version.
+ *
+ * This source code is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * Please refer to the GNU Public License for more details.
+ *
+ * You should have received a copy of the GNU Public License along with
+ * this source code; if not, write to:
+ * Free Software Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+
+// Benchmark of the octet base64 and hex codecs: the path used before
+// zen_codec.c (character check, then Milagro's OCT_* conversion) is
+// compared with each implementation of zen_codec.c supported by the
+// CPU, on payloads of the sizes found in keys and ciphertexts.
+//
+// build and run with: make codec-bench
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <sys/time.h>
+
+#include <amcl.h>
+#include <zen_codec.h>
+
+#define ROUNDS_BYTES (64*1024*1024) // bytes processed per measure
+
+static double now() {
+	struct timeval tv;
+	gettimeofday(&tv, NULL);
+	return (double)tv.tv_sec + 1.0e-6*(double)tv.tv_usec;
+}
+
+// previous validation in zen_octet.c
+static int is_base64(const char *in) {
+	int c;
+	for(c=0; in[c]!='\0'; c++)
+		if (!(isalnum(in[c]) || '+' == in[c] || '=' == in[c] || '/' == in[c]))
+			return 0;
+	return c;
+}
+static int is_hex(const char *in) {
+	int c;
+	for(c=0; in[c]!='\0'; c++)
+		if (!isxdigit(in[c])) return 0;
+	return c;
+}
+
+static void report(const char *what, const char *impl, size_t size,
+                   int rounds, double elapsed, double base) {
+	double mbs = (double)size * rounds / elapsed / (1024*1024);
+	if(base > 0)
+		printf("%-10s %-8s %6zu B  %9.1f MiB/s  %5.2fx\n",
+		       what, impl, size, mbs, base / elapsed);
+	else
+		printf("%-10s %-8s %6zu B  %9.1f MiB/s\n", what, impl, size, mbs);
+}
+
+static void bench_size(size_t size) {
+	static const char *impl[] = { "scalar", "ssse3", "avx2", NULL };
+	int rounds = ROUNDS_BYTES / size, r, k;
+	unsigned char *bin = malloc(size);
+	unsigned char *dec = malloc(size + 64);
+	char *b64 = malloc(B64_ENCLEN(size) + 64);
+	char *hex = malloc(size*2 + 64);
+	octet o = { 0, (int)size + 64, malloc(size + 64) };
+	double t, base_b64e, base_b64d, base_hexe, base_hexd;
+	size_t c;
+	for(c=0; c<size; c++) bin[c] = rand();
+	memcpy(o.val, bin, size);
+	o.len = size;
+
+	t = now();
+	for(r=0; r<rounds; r++) OCT_tobase64(b64, &o);
+	base_b64e = now() - t;
+	report("b64 enc", "milagro", size, rounds, base_b64e, 0);
+	t = now();
+	for(r=0; r<rounds; r++) { is_base64(b64); OCT_frombase64(&o, b64); }
+	base_b64d = now() - t;
+	report("b64 dec", "milagro", size, rounds, base_b64d, 0);
+	t = now();
+	for(r=0; r<rounds; r++) OCT_toHex(&o, hex);
+	base_hexe = now() - t;
+	report("hex enc", "milagro", size, rounds, base_hexe, 0);
+	t = now();
+	for(r=0; r<rounds; r++) { is_hex(hex); OCT_fromHex(&o, hex); }
+	base_hexd = now() - t;
+	report("hex dec", "milagro", size, rounds, base_hexd, 0);
+
+	for(k=0; impl[k]; k++) {
+		size_t len;
+		if(!zen_codec_select(impl[k])) continue;
+		t = now();
+		for(r=0; r<rounds; r++) len = zen_base64_encode(b64, bin, size);
+		report("b64 enc", impl[k], size, rounds, now() - t, base_b64e);
+		t = now();
+		for(r=0; r<rounds; r++) zen_base64_decode(dec, size + 64, b64, len);
+		report("b64 dec", impl[k], size, rounds, now() - t, base_b64d);
+		if(memcmp(dec, bin, size)) printf("ERROR: %s base64 mismatch\n", impl[k]);
+		t = now();
+		for(r=0; r<rounds; r++) len = zen_hex_encode(hex, bin, size);
+		report("hex enc", impl[k], size, rounds, now() - t, base_hexe);
+		t = now();
+		for(r=0; r<rounds; r++) zen_hex_decode(dec, size + 64, hex, len);
+		report("hex dec", impl[k], size, rounds, now() - t, base_hexd);
+		if(memcmp(dec, bin, size)) printf("ERROR: %s hex mismatch\n", impl[k]);
+	}
+	free(bin); free(dec); free(b64); free(hex); free(o.val);
+}
+
+int main() {
+	static const size_t sizes[] = { 32, 64, 97, 256, 4096, 65536, 0 };
+	int c;
+	printf("best codec on this CPU: %s\n", zen_codec_name());
+	for(c=0; sizes[c]; c++) {
+		bench_size(sizes[c]);
+		printf("\n");
+	}
+	return 0;
+}
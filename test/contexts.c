@@ -0,0 +1,237 @@
+/*  Zenroom (DECODE project)
+ *
+ *  (c) Copyright 2017-2018 Dyne.org foundation
+ *  designed, written and maintained by Denis Roio <jaromil@dyne.org>
+ *
+ * This source code is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Public License as published
+ * by the Free Software Foundation; either version 3 of the License,
+ * or (at your option) any later version.
+ *
+ * This source code is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * Please refer to the GNU Public License for more details.
+ *
+ * You should have received a copy of the GNU Public License along with
+ * this source code; if not, write to:
+ * Free Software Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+
+// Checks the lifecycle of contexts reused across executions: a pool
+// must give back each context as it was after initialisation, both
+// when reset from a umm heap snapshot and when reset on the Lua side,
+// and a restored snapshot must leave the heap exactly as it was saved,
+// also when the heap grew by new regions after the snapshot. Octets
+// kept in globals must survive the arena reset after each execution.
+//
+// build and run with: make contexts
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <jutils.h>
+#include <zenroom.h>
+
+// prototypes from zen_memory.c and umm_malloc.c
+extern void *zen_memory_snapshot(zen_mem_t *mem);
+extern size_t zen_memory_snapshot_size(void *img);
+extern int umm_integrity_check(void *heap);
+extern size_t umm_image_size(void *heap);
+
+#define OUTMAX 4096
+#define POOL_RUNS 8
+
+// leaves traces in a global, in a module and in the string methods,
+// and fails if it finds those of a previous run. print adds no
+// newline when writing to a buffer
+static const char *dirty =
+	"assert(not LEFTOVER, 'global left by a previous run')\n"
+	"assert(not json.leftover, 'field left in a module')\n"
+	"assert(not string.leftover, 'field left in the string methods')\n"
+	"LEFTOVER = { } for i=1,100 do LEFTOVER[i] = string.rep('x', i) end\n"
+	"json.leftover = true\n"
+	"string.leftover = true\n"
+	"print((DATA or 'none') .. '\\n')\n";
+
+static int fail(const char *conf, const char *msg) {
+	fprintf(stderr, "contexts (conf %s): %s\n", conf ? conf : "none", msg);
+	return 0;
+}
+
+// runs the same script on a pool, alternating executions with and
+// without DATA, which must not survive either
+static int pool_runs(const char *conf) {
+	static char out[OUTMAX], err[OUTMAX];
+	zen_pool_t *P;
+	int i, r;
+	printf("== pool reset (conf %s)\n", conf ? conf : "none");
+	P = zen_pool_init(conf, 2);
+	if(!P) return fail(conf, "pool initialisation failed");
+	for(i=0; i<POOL_RUNS; i++) {
+		memset(out, 0, OUTMAX);
+		memset(err, 0, OUTMAX);
+		r = zenroom_pool_exec_tobuf(P, (char*)dirty, NULL,
+		                            i%2 ? "data" : NULL,
+		                            out, OUTMAX-1, err, OUTMAX-1);
+		if(r) {
+			fprintf(stderr, "%s\n", err);
+			zen_pool_teardown(P);
+			return fail(conf, "state of a previous run found in the pool"); }
+		if(strcmp(out, i%2 ? "data\n" : "none\n")) {
+			zen_pool_teardown(P);
+			return fail(conf, "unexpected output from the pool"); }
+	}
+	zen_pool_teardown(P);
+	return 1;
+}
+
+// changes a global saved in the snapshot and allocates many small
+// blocks, or a few big ones which need new heap regions
+static const char *mutate_small =
+	"assert(KEPT == 'saved')\n"
+	"KEPT = 'changed'\n"
+	"ADDED = { }\n"
+	"for i=1,2000 do ADDED[i] = string.rep('y', i % 97) end\n";
+static const char *mutate_grow =
+	"assert(KEPT == 'saved')\n"
+	"KEPT = 'changed'\n"
+	"ADDED = { }\n"
+	"for i=1,128 do ADDED[i] = string.rep(string.char(65 + i % 26), 8192) end\n";
+
+// heap image saved by zen_snapshot must come back byte for byte
+// after a script changed globals and allocated on the heap
+static int snapshot_restore(const char *conf, const char *mutate, int grow) {
+	zenroom_t *Z;
+	void *img = NULL;
+	int ok = 0;
+	printf("== snapshot and restore%s (conf %s)\n",
+	       grow ? " across heap regions" : "", conf);
+	Z = zen_init(conf, NULL, NULL);
+	if(!Z) return fail(conf, "initialisation failed");
+	if(zen_exec_script(Z, "KEPT = 'saved'")) {
+		fail(conf, "execution failed");
+		goto end; }
+	if(!zen_snapshot(Z)) {
+		fail(conf, "snapshot failed");
+		goto end; }
+	if(zen_exec_script(Z, mutate)) {
+		fail(conf, "execution failed");
+		goto end; }
+	if(grow && umm_image_size(Z->mem->heap)
+	   <= zen_memory_snapshot_size(Z->snapshot)) {
+		fail(conf, "heap did not grow after the snapshot");
+		goto end; }
+	if(!zen_restore(Z)) {
+		fail(conf, "restore failed");
+		goto end; }
+	if(!umm_integrity_check(Z->mem->heap)) {
+		fail(conf, "heap integrity check failed after restore");
+		goto end; }
+	img = zen_memory_snapshot(Z->mem);
+	if(!img
+	   || zen_memory_snapshot_size(img) != zen_memory_snapshot_size(Z->snapshot)
+	   || memcmp(img, Z->snapshot,
+	             sizeof(size_t) + zen_memory_snapshot_size(img))) {
+		fail(conf, "restored heap differs from the snapshot");
+		goto end; }
+	if(zen_exec_script(Z, "assert(KEPT == 'saved') assert(ADDED == nil)")) {
+		fail(conf, "globals differ from the snapshot");
+		goto end; }
+	ok = 1;
+ end:
+	free(img);
+	zen_teardown(Z);
+	return ok;
+}
+
+// a heap=SIZE heap grows by regions up to SIZE and no further,
+// leaving the context usable after running out of memory
+static int heap_limit(const char *conf, size_t limit) {
+	zenroom_t *Z;
+	size_t start;
+	int ok = 0;
+	printf("== heap growth by regions (conf %s)\n", conf);
+	Z = zen_init(conf, NULL, NULL);
+	if(!Z) return fail(conf, "initialisation failed");
+	start = umm_image_size(Z->mem->heap);
+	if(zen_exec_script(Z,
+	     "BIG = { }\n"
+	     "for i=1,64 do BIG[i] = string.rep(string.char(65 + i % 26), 8192) end\n")) {
+		fail(conf, "allocation within the limit failed");
+		goto end; }
+	if(umm_image_size(Z->mem->heap) <= start) {
+		fail(conf, "heap did not grow");
+		goto end; }
+	if(!zen_exec_script(Z,
+	     "local t = { }\n"
+	     "for i=1,1024 do t[i] = string.rep('z', 8192) end\n")) {
+		fail(conf, "allocation beyond the limit succeeded");
+		goto end; }
+	if(umm_image_size(Z->mem->heap) > limit) {
+		fail(conf, "heap grew beyond the limit");
+		goto end; }
+	if(!umm_integrity_check(Z->mem->heap)) {
+		fail(conf, "heap integrity check failed");
+		goto end; }
+	if(zen_exec_script(Z,
+	     "for i=1,64 do assert(BIG[i] == string.rep(string.char(65 + i % 26), 8192)) end\n")) {
+		fail(conf, "context unusable after running out of memory");
+		goto end; }
+	ok = 1;
+ end:
+	zen_teardown(Z);
+	return ok;
+}
+
+// octets allocated in the arena and kept in globals are moved out
+// of it before the arena is emptied at the end of an execution. Only
+// payloads bigger than OCTET_INLINE (256 bytes) come from the arena
+static const char *arena_keep =
+	"octet = require'octet'\n"
+	"KEEP = octet.from_string(string.rep('kept across executions', 20))\n"
+	"NESTED = { octet.from_string(string.rep('n', 1000)) }\n"
+	"SMALL = octet.from_string('inline')\n"
+	"for i=1,200 do local o = octet.from_string(string.rep('t', 256 + i)) end\n";
+static const char *arena_check =
+	"assert(KEEP:string() == string.rep('kept across executions', 20))\n"
+	"assert(NESTED[1]:string() == string.rep('n', 1000))\n"
+	"assert(SMALL:string() == 'inline')\n"
+	"for i=1,200 do local o = octet.from_string(string.rep('u', 256 + i)) end\n";
+
+static int arena_survive(const char *conf) {
+	zenroom_t *Z;
+	int i, ok = 0;
+	printf("== octets in globals survive the arena (conf %s)\n", conf);
+	Z = zen_init(conf, NULL, NULL);
+	if(!Z) return fail(conf, "initialisation failed");
+	if(zen_exec_script(Z, arena_keep)) {
+		fail(conf, "execution failed");
+		goto end; }
+	for(i=0; i<3; i++)
+		if(zen_exec_script(Z, arena_check)) {
+			fail(conf, "octet changed after the arena reset");
+			goto end; }
+	ok = 1;
+ end:
+	zen_teardown(Z);
+	return ok;
+}
+
+int main() {
+	set_debug(1);
+
+	printf("= test contexts reused across executions\n");
+	if(!pool_runs(NULL)) return 1;
+	if(!pool_runs("umm,heap=4M")) return 1;
+	if(!snapshot_restore("umm,heap=4M", mutate_small, 0)) return 1;
+	if(!snapshot_restore("umm,heap=4M", mutate_grow, 1)) return 1;
+	if(!heap_limit("umm,heap=2M", 2*1024*1024)) return 1;
+	if(!heap_limit("umm,heap=2M,slab", 2*1024*1024)) return 1;
+	if(!arena_survive("arena")) return 1;
+	if(!arena_survive("umm,heap=4M,arena")) return 1;
+
+	printf("= OK\n");
+	return 0;
+}
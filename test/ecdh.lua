@@ -20,6 +20,10 @@ function test_curve (name)
    -- print(sk:hex())
    -- print(curve:private():hex())
    assert(sk:hex() == curve:private():hex())
+   -- importing the private key derives the same public key
+   imported = ecdh.new(name)
+   imported:private(sk)
+   assert(imported:public() == pk)
 
    ses = curve:session(pk,sk)
    -- print 'session:'
@@ -35,7 +39,45 @@ function test_curve (name)
 
    decipher = curve:decrypt(ses,ciphermsg)
 
+   -- batch calls give the same session keys and ciphertexts
+   batch = curve:session_batch({ pk, curve })
+   assert(batch[1] == ses and batch[2] == ses)
+   envelopes = curve:encrypt_batch({ self = pk }, octet.from_string(secret))
+   assert(envelopes.self == ciphermsg)
+
    assert(secret == decipher:string())
+
+   -- signatures, one by one and in a batch
+   msg = octet.from_string(secret)
+   sig = curve:sign(msg)
+   assert(curve:verify(msg, sig))
+   other = ecdh.new(name)
+   other:keygen()
+   assert(not other:verify(msg, sig))
+   osig = other:sign(msg)
+   valid = curve:verify_batch({ curve, other, pk, other, pk },
+      { msg, msg, msg, octet.from_string('tampered'), msg },
+      { sig, osig, osig, osig, { r = sig.r } })
+   assert(#valid == 5)
+   assert(valid[1] and valid[2])
+   assert(not valid[3] and not valid[4] and not valid[5])
+
+   -- streaming cipher fed in uneven chunks gives the same result
+   enc = curve:encrypt_stream(ses)
+   streamed = enc:update(secret:sub(1,100)) .. enc:update(secret:sub(101)) .. enc:final()
+   assert(streamed == ciphermsg)
+   dec = curve:decrypt_stream(ses)
+   assert(secret == dec:update(streamed:sub(1,33)):string()
+             .. dec:update(streamed:sub(34)):string()
+             .. dec:final():string())
+
+   -- incremental hash and hmac match the one-shot ones
+   h = curve:hash_stream()
+   h:update(secret:sub(1,50)):update(secret:sub(51))
+   assert(h:final() == curve:hash(octet.from_string(secret)))
+   h = curve:hmac_stream(ses)
+   h:update(secret:sub(1,200)):update(secret:sub(201))
+   assert(h:final() == curve:hmac(ses, octet.from_string(secret)))
    -- print 'decipher message:'
    -- print(decipher:string())
    -- print(#decipher)
@@ -48,3 +90,31 @@ test_curve('nist256')
 -- test_curve('goldilocks')
 test_curve('bn254cx')
 test_curve('fp256bn')
+
+print '  nist256 key and signature vectors'
+curve = ecdh.new('nist256')
+curve:private(octet.from_hex('e5ae109ac9be60390b03257a073ccdec8e017c75165c1e01b3817bf120656c64'))
+assert(curve:public():hex() == '040fefdf365817bf8fe172530065711e5560791580d266fc9e372c2c5dda755325fe607f470ae4f64fc1e54ffc7d84ef25dc457d06ea8ed8b1fe6a8b2867af6411')
+msg = octet.from_string('Hello World!')
+sig = curve:sign(msg, octet.from_hex('8341425cafede9d24b0599aefdfdeff1c1526ed75b07217eb99bf8c0b7498b81'))
+assert(sig.r:hex() == '9a781ca6d055a7f30d0c9ff87936c739f6816ef5f5e72b4b946404b0a1a83b2a')
+assert(sig.s:hex() == 'f6449ee0f834c6b5d02908b82b2e5cd6193b297175a87d49c44bdf23bbf88f2f')
+assert(curve:verify(msg, sig))
+print ('         OK')
+
+print '  keyrings sharing the random generator'
+seen = { }
+for i=1,300 do
+   curve = ecdh.new(({ 'ed25519', 'nist256', 'bn254cx' })[i % 3 + 1])
+   rnd = curve:random(32):hex()
+   assert(not seen[rnd])
+   seen[rnd] = true
+end
+assert(not pcall(ecdh.new, 'nocurve'))
+-- one keyring drawing past the reseed limit of the generator
+for i=1,40 do
+   rnd = curve:random(4096):hex()
+   assert(not seen[rnd])
+   seen[rnd] = true
+end
+print ('         OK')
@@ -65,3 +65,57 @@ assert( ecp1:double() == ecp1 * 2)
 assert( ecp1 + ecp1 + ecp1 ~= ecp1 + ecp1)
 assert( (ecp1:negative() + ecp1):isinf() )
 print "OK"
+
+print "test multi-scalar multiplication"
+assert(ecp.msm({ ecp1, ecp2 }, { bigscalar, 3 }) == ecp1 * bigscalar + ecp2 * 3)
+points = { }
+numbers = { }
+pt = ecp1
+sum = nil
+for i=1,50 do
+   pt = pt + ecp2
+   points[i] = pt
+   numbers[i] = i * 7919
+   if sum then sum = sum + pt * numbers[i] else sum = pt * numbers[i] end
+end
+assert(ecp.msm(points, numbers) == sum)
+print "OK"
+
+print "test other curves"
+for _,name in ipairs({ 'nist256', 'goldilocks', 'bn254cx', 'fp256bn' }) do
+   local G = ecp.generator(name)
+   assert(not G:isinf())
+   assert(G:double() == G + G)
+   assert(G * 3 == G + G + G)
+   assert(G * 5 - G * 2 == G * 3)
+   assert((G:negative() + G):isinf())
+   assert(ecp.new(name):isinf())
+   local P = ecp.new(name, octet.from_hex('00'), octet.from_hex('00'))
+   P:octet(G:octet())
+   assert(P == G)
+   assert(ecp.msm({ G, G:double() }, { 7, 11 }) == G * 29)
+   assert(G ~= ecp.generator())
+   assert(not pcall(function() return G + ecp.generator() end))
+end
+print "OK"
+
+print "test batch normalisation"
+for _,name in ipairs({ 'ed25519', 'nist256', 'goldilocks' }) do
+   local G = ecp.generator(name)
+   local a = { }
+   local b = { }
+   for i=1,20 do
+      a[i] = G * (i * 31) + G
+      b[i] = G * (i * 31) + G
+   end
+   a[21] = G - G
+   b[21] = G - G
+   assert(ecp.normalise(a) >= 20)
+   assert(ecp.normalise(a) <= 1) -- only infinity is left
+   for i=1,21 do
+      assert(a[i] == b[i])
+      assert(tostring(a[i]) == tostring(b[i]))
+      if i <= 20 then assert(a[i]:octet() == b[i]:octet()) end
+   end
+end
+print "OK"
@@ -0,0 +1,42 @@
+-- Benchmark of ecp.msm against separate multiplications and
+-- additions, from 2 to 1024 terms. Run with: make ecp-msm-bench
+
+ecp = require'ecp'
+kr = ecdh.new('ed25519')
+
+local base = ecp.new(
+   octet.from_hex('77B7CB8C1B285FBD40D9BC49D3DA20489CC18272EEDDD057E7120E1DE38A3B5C'),
+   octet.from_hex('67D0E5D15854E75154DEF7EB3CE0C3E8B3997347AB8061D8DE8F6BAAE02A154F'))
+
+local points = { base }
+local numbers = { kr:random(32) }
+for i=2,1024 do
+   points[i] = points[i-1]:double() + base
+   numbers[i] = kr:random(32)
+end
+
+local function naive(n)
+   local sum = points[1] * numbers[1]
+   for i=2,n do sum = sum + points[i] * numbers[i] end
+   return sum
+end
+
+local function msm(n)
+   local p, k = { }, { }
+   for i=1,n do p[i] = points[i]; k[i] = numbers[i] end
+   return ecp.msm(p, k)
+end
+
+print(string.format("%6s %12s %12s %8s", "terms", "naive ms", "msm ms", "speedup"))
+local n = 2
+while n <= 1024 do
+   local t = os.clock()
+   local a = naive(n)
+   local tn = os.clock() - t
+   t = os.clock()
+   local b = msm(n)
+   local tm = os.clock() - t
+   assert(a == b)
+   print(string.format("%6d %12.2f %12.2f %7.1fx", n, tn*1000, tm*1000, tn/tm))
+   n = n * 2
+end
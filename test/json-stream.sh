@@ -0,0 +1,30 @@
+#!/usr/bin/env zsh
+
+echo "= test streaming JSON decode of a large array on stdin"
+cat <<EOF > /tmp/zenroom_temp_check.lua
+json = require'json'
+sum = 0
+n = json.decode_each(io.input(), function(v, i)
+	assert(v.id == i)
+	assert(v.text == "record number " .. i)
+	assert(#v.pad == 64)
+	sum = sum + v.id
+end)
+assert(n == 5000)
+assert(sum == 5000 * 5001 / 2)
+EOF
+
+# about 500KiB, well above the MAX_FILE limit of DATA
+pad=${(l:64::x:)}
+{
+	print -n "["
+	for i in {1..5000}; do
+		[[ $i -gt 1 ]] && print -n ","
+		print "{\"id\":$i,\"text\":\"record number $i\",\"pad\":\"$pad\"}"
+	done
+	print "]"
+} > /tmp/zenroom_stream.json
+
+${1} /tmp/zenroom_temp_check.lua < /tmp/zenroom_stream.json || return 1
+
+echo "= OK"
@@ -0,0 +1,136 @@
+print()
+print '= JSON DECODE TESTS'
+print()
+
+json = require'json'
+octet = require'octet'
+
+-- decode_each with the same input split in chunks of n bytes
+function each(str, n)
+   local res = { }
+   local pos = 1
+   local src = str
+   if n then
+	  src = function()
+		 if pos > #str then return nil end
+		 local chunk = string.sub(str, pos, pos + n - 1)
+		 pos = pos + n
+		 return chunk
+	  end
+   end
+   local count = json.decode_each(src, function(v, i)
+									 res[i] = v
+   end)
+   assert(count == #res)
+   return res
+end
+
+function same(l, r)
+   assert(json.encode(l) == json.encode(r))
+end
+
+print '== elements of an array'
+doc = '[ {"a":1,"b":[true,false,null]}, "str\\"ing]", 3.5, [], {"c":{"d":"}"}} ]'
+whole = json.decode(doc)
+for _,n in ipairs({ false, 1, 2, 3, 7, 64 }) do
+   same(each(doc, n or nil), whole)
+end
+assert(#each('[]') == 0)
+assert(#each('  [ ] ') == 0)
+
+print '== sequence of values'
+ndjson = '{"id":1}\n{"id":2,"s":"a\\\\"}\n  "three" 4 [5]\n'
+for _,n in ipairs({ false, 1, 5 }) do
+   res = each(ndjson, n or nil)
+   assert(#res == 5)
+   assert(res[1].id == 1 and res[2].s == 'a\\')
+   assert(res[3] == 'three' and res[4] == 4 and res[5][1] == 5)
+end
+
+print '== stop from the callback'
+n = json.decode_each('[1,2,3,4]', function(v, i) return i < 2 end)
+assert(n == 2)
+
+print '== malformed input'
+for _,bad in ipairs({ '[1,,2]', '[1,]', '[1 2]', '[1,2', '[1] 2',
+					  '{"a":', '"open', '[{"a"}]', '{}]' }) do
+   assert(not pcall(each, bad), bad)
+   assert(not pcall(each, bad, 1), bad)
+end
+assert(not pcall(json.decode_each, '[1]'))
+assert(not pcall(json.decode_each, function() return 1 end, print))
+
+print '== input larger than MAX_FILE'
+item = '{"data":"' .. string.rep('A', 500) .. '"}'
+sent = 0
+total = 0
+n = json.decode_each(function()
+	  sent = sent + 1
+	  if sent == 1 then return '[' .. item end
+	  if sent <= 200 then return ',' .. item end
+	  if sent == 201 then return ']' end
+   end, function(v, i)
+	  total = total + #v.data
+end)
+assert(n == 200 and total == 200 * 500)
+
+print '== select with paths'
+doc = [[{ "keys": { "alice": { "pk": "aa", "sk": "a1" },
+					"bob":   { "pk": "bb", "sk": "b1" } },
+		  "list": [ 10, { "x": [1,2] }, "three", null ],
+		  "odd key": true, "skip": [ { "deep": [ [ [ "me" ] ] ] } ] }]]
+whole = json.decode(doc)
+same(json.select(doc, '$'), { whole })
+same(json.select(doc, '$.keys.alice.pk'), { 'aa' })
+same(json.select(doc, "$['odd key']"), { true })
+same(json.select(doc, '$.list[0]'), { 10 })
+same(json.select(doc, '$.list[1].x[1]'), { 2 })
+same(json.select(doc, '$.list[9]'), { })
+same(json.select(doc, '$.missing.path'), { })
+same(json.select(doc, '$.list[*]'), whole.list)
+assert(#json.select(doc, '$.keys.*.pk') == 2)
+assert(json.select(doc, '$.list[3]')[1] == json.null)
+-- all paths in one pass, also when one contains the other
+a, b, c, d = json.select(doc, '$.keys.bob.sk', '$.list[1]',
+						 '$.list[1].x[*]', '$.list.*.x[0]')
+same(a, { 'b1' })
+same(b, { { x = { 1, 2 } } })
+same(c, { 1, 2 })
+same(d, { 1 })
+-- the parts skipped are still checked
+assert(not pcall(json.select, '{"a":1,"b":[1 2]}', '$.a'))
+assert(not pcall(json.select, '{"a":1} x', '$.a'))
+for _,bad in ipairs({ '', 'keys', '$.', '$..keys', '$[x]', '$[1',
+					  "$['a]", '$[99999999999]' }) do
+   assert(not pcall(json.select, doc, bad), bad)
+end
+
+print '== decode fields into octets'
+bin = octet.from_hex('00ff10203040')
+doc = json.encode({ pk = bin:base64(), sk = bin:hex(), name = 'alice',
+					n = 3, raw = 'x\0y',
+					list = { { h = bin:hex(), t = 'keep' }, { h = '00' } },
+					many = { bin:base64(), bin:base64() },
+					other = { pk = 'not decoded' } })
+map = { pk = 'base64', sk = 'hex', raw = 'string', n = 'hex',
+		list = { h = 'hex' }, many = 'base64' }
+for _,dec in ipairs({ json.decode, require'cjson_full'.decode }) do
+   t = dec(doc, map)
+   assert(t.pk == bin and t.sk == bin)
+   assert(#t.raw == 3 and t.raw:hex() == '780079')
+   assert(t.name == 'alice' and t.n == 3)
+   assert(t.list[1].h == bin and t.list[2].h:hex() == '00')
+   assert(t.list[1].t == 'keep')
+   assert(t.many[1] == bin and t.many[2] == bin)
+   assert(t.other.pk == 'not decoded')
+   same(dec(doc, nil), dec(doc))
+end
+assert(#json.decode('{"e":""}', { e = 'hex' }).e == 0)
+assert(not json.decode('{"pk":"@@@@"}', { pk = 'base64' }))
+assert(not json.decode('{"sk":"abc"}', { sk = 'hex' }))
+assert(not json.decode('{"pk":"AA=="}', { pk = 'base32' }))
+assert(not pcall(json.decode, doc, map, 1))
+assert(not pcall(json.decode))
+assert(not pcall(json.encode, {}, map))
+
+print '= OK'
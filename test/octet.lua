@@ -55,6 +55,36 @@ assert(left == right)
 assert(left:hex() == testhex)
 assert(ecc:hash(left) == ecc:hash(right))
 
+print '== test octet views'
+iv, ct, tag = right:sub(1,16), right:sub(17,-17), right:sub(-16)
+-- compared in hex: random bytes may contain a zero, where :string() stops
+dotest(iv:hex(), string.sub(testhex, 1, 32))
+dotest(ct:hex(), string.sub(testhex, 33, -33))
+dotest(tag:hex(), string.sub(testhex, -32))
+dotest(ct:sub(2,3):hex(), string.sub(testhex, 35, 38))
+assert(iv..ct..tag == right)
+assert(ecc:hash(iv..ct..tag) == ecc:hash(right))
+-- the view keeps its parent alive
+tag = ecc:random(64):sub(-16)
+collectgarbage()
+dotest(#tag, 16)
+assert(not pcall(function() return iv:sub(3,2) end))
+
+print '== test random'
+seen = { }
+for i=1,200 do
+   rnd = octet.new(48)
+   rnd:random(48)
+   dotest(#rnd, 48)
+   assert(not seen[rnd:hex()])
+   seen[rnd:hex()] = true
+end
+-- more than a refill of the generator at once
+rnd = octet.new(2048)
+rnd:random()
+dotest(#rnd, 2048)
+assert(rnd:sub(1,1024) ~= rnd:sub(1025,2048))
+
 print '= OK'
 
 
@@ -0,0 +1,76 @@
+print()
+print '= MEMORY PROFILE TESTS (conf profile)'
+print()
+
+stats = { 'allocs', 'reallocs', 'frees', 'live', 'peak', 'time' }
+types = { 'other', 'string', 'table', 'function', 'userdata', 'thread', 'proto' }
+
+function check_stat(s)
+   for _,k in ipairs(stats) do
+	  assert(type(s[k]) == 'number', 'missing field: '..k)
+	  assert(s[k] >= 0)
+   end
+   assert(s.peak >= s.live)
+end
+
+-- sums a field over the stats of a table
+function sum(t, k)
+   local res = 0
+   for _,s in pairs(t) do res = res + s[k] end
+   return res
+end
+
+function check(p)
+   assert(p, 'memory_profile() needs conf profile')
+   assert(math.type(p.live) == 'integer')
+   assert(math.type(p.peak) == 'integer')
+   assert(p.live > 0)
+   assert(p.peak >= p.live)
+   for _,t in ipairs(types) do check_stat(p.types[t]) end
+   assert(#p.buckets == 16)
+   for i,b in ipairs(p.buckets) do
+	  check_stat(b)
+	  if i < 16 then assert(b.max == 16 << (i-1))
+	  else assert(b.max == nil) end
+   end
+   -- every allocation is counted once by type and once by size
+   assert(sum(p.types, 'live') == p.live)
+   assert(sum(p.buckets, 'live') == p.live)
+   for _,k in ipairs({ 'allocs', 'reallocs', 'frees' }) do
+	  assert(sum(p.types, k) == sum(p.buckets, k), 'mismatch in '..k)
+   end
+   -- the type of a block never changes
+   for _,t in ipairs(types) do
+	  local s = p.types[t]
+	  assert(s.allocs >= s.frees)
+	  if s.live > 0 then assert(s.allocs > 0) end
+   end
+end
+
+print '== fields and consistency after initialisation'
+before = memory_profile()
+check(before)
+for _,t in ipairs({ 'string', 'table', 'function', 'proto' }) do
+   assert(before.types[t].allocs > 0, 'no allocation of type '..t)
+end
+
+print '== counts grow with allocations'
+KEEP = { }
+for i=1,1000 do KEEP[i] = { string.rep('p', 100 + i) } end
+after = memory_profile()
+check(after)
+assert(after.types.string.allocs >= before.types.string.allocs + 1000)
+assert(after.types.table.allocs >= before.types.table.allocs + 1000)
+assert(after.live > before.live + 1000 * 100)
+assert(after.peak >= before.peak)
+
+print '== live drops after collection'
+KEEP = nil
+collectgarbage()
+collected = memory_profile()
+check(collected)
+assert(collected.live < after.live)
+assert(collected.types.string.frees >= after.types.string.frees + 1000)
+assert(collected.peak >= after.peak)
+
+print '= OK'
@@ -0,0 +1,32 @@
+#!/usr/bin/env zsh
+
+echo "= test deterministic random numbers with conf seed"
+cat <<EOF > /tmp/zenroom_temp_check.lua
+ecdh = require'ecdh'
+octet = require'octet'
+rnd = octet.new(64)
+rnd:random(64)
+print(rnd:hex())
+for _,curve in ipairs({ 'ed25519', 'nist256' }) do
+   ecc = ecdh.new(curve)
+   pk = ecc:keygen()
+   print(pk:hex())
+   print(ecc:random(32):hex())
+   sig = ecc:sign(octet.from_string('message'))
+   print(sig.r:hex(), sig.s:hex())
+end
+EOF
+
+${1} -c seed=0123456789abcdef0123456789abcdef \
+	/tmp/zenroom_temp_check.lua > /tmp/zenroom_seed_1.txt || return 1
+${1} -c seed=0123456789abcdef0123456789abcdef \
+	/tmp/zenroom_temp_check.lua > /tmp/zenroom_seed_2.txt || return 1
+${1} -c seed=fedcba9876543210fedcba9876543210 \
+	/tmp/zenroom_temp_check.lua > /tmp/zenroom_seed_3.txt || return 1
+
+echo "== same seed gives the same output"
+cmp /tmp/zenroom_seed_1.txt /tmp/zenroom_seed_2.txt || return 1
+echo "== another seed gives another output"
+cmp -s /tmp/zenroom_seed_1.txt /tmp/zenroom_seed_3.txt && return 1
+
+echo "= OK"
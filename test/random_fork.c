@@ -0,0 +1,134 @@
+/*  Zenroom (DECODE project)
+ *
+ *  (c) Copyright 2017-2018 Dyne.org foundation
+ *  designed, written and maintained by Denis Roio <jaromil@dyne.org>
+ *
+ * This source code is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Public License as published
+ * by the Free Software Foundation; either version 3 of the License,
+ * or (at your option) any later version.
+ *
+ * This source code is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * Please refer to the GNU Public License for more details.
+ *
+ * You should have received a copy of the GNU Public License along with
+ * this source code; if not, write to:
+ * Free Software Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+
+// Checks that a context forked with live keyrings does not repeat the
+// random numbers of its parent: random bytes, signature nonces and
+// keys drawn after fork() must all differ between parent and child,
+// unless the context is deterministic (conf "seed=HEX").
+//
+// build and run with: make random-fork
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+
+#include <jutils.h>
+#include <zenroom.h>
+
+#define OUTMAX 4096
+
+// keyrings created and seeded before fork()
+static const char *setup =
+	"ecdh = require'ecdh'\n"
+	"octet = require'octet'\n"
+	"ecc = ecdh.new('nist256')\n"
+	"ecc:keygen()\n"
+	"msg = octet.from_string('message')\n";
+
+// one line for each kind of random number drawn after fork(), print
+// adds no newline when writing to a buffer
+static const char *draw =
+	"print(ecc:random(32):hex() .. '\\n')\n"
+	"sig = ecc:sign(msg)\n"
+	"print(sig.r:hex() .. '\\n')\n"
+	"kr = ecdh.new('ed25519')\n"
+	"print(kr:keygen():hex() .. '\\n')\n";
+
+static int fail(const char *msg) {
+	fprintf(stderr, "random-fork: %s\n", msg);
+	return 1;
+}
+
+// runs draw in a context forked after setup: the output of the parent
+// goes in out[0] and the one of the child in out[1]
+static int fork_draw(const char *conf, char out[2][OUTMAX]) {
+	zenroom_t *Z;
+	int fd[2], status;
+	pid_t pid;
+	ssize_t n;
+	size_t got = 0;
+	memset(out, 0, 2*OUTMAX);
+	Z = zen_init(conf, NULL, NULL);
+	if(!Z) return 0;
+	if(zen_exec_script(Z, setup) || pipe(fd)) {
+		zen_teardown(Z);
+		return 0; }
+	pid = fork();
+	if(pid < 0) {
+		zen_teardown(Z);
+		return 0; }
+	Z->stdout_buf = out[pid ? 0 : 1];
+	Z->stdout_len = OUTMAX - 1;
+	Z->stdout_pos = 0;
+	if(!pid) { // child: hand the output over to the parent
+		close(fd[0]);
+		if(zen_exec_script(Z, draw)) _exit(1);
+		if(write(fd[1], out[1], OUTMAX) != OUTMAX) _exit(1);
+		_exit(0);
+	}
+	close(fd[1]);
+	if(zen_exec_script(Z, draw)) got = OUTMAX + 1;
+	while(got < OUTMAX && (n = read(fd[0], out[1] + got, OUTMAX - got)) > 0)
+		got += n;
+	close(fd[0]);
+	waitpid(pid, &status, 0);
+	Z->stdout_buf = NULL;
+	zen_teardown(Z);
+	return got == OUTMAX && WIFEXITED(status) && !WEXITSTATUS(status);
+}
+
+// number of lines found the same in parent and child, -1 if the
+// outputs have a different number of lines
+static int same_lines(char out[2][OUTMAX]) {
+	char *p = out[0], *c = out[1], *pe, *ce;
+	int same = 0;
+	while(*p && *c) {
+		pe = strchr(p, '\n');
+		ce = strchr(c, '\n');
+		if(!pe || !ce) return -1;
+		if(pe - p == ce - c && !memcmp(p, c, pe - p)) same++;
+		p = pe + 1;
+		c = ce + 1;
+	}
+	return (*p || *c) ? -1 : same;
+}
+
+int main() {
+	static char out[2][OUTMAX];
+	set_debug(1);
+
+	printf("= test random numbers drawn after fork() from live keyrings\n");
+	if(!fork_draw(NULL, out))
+		return fail("execution failed");
+	if(!out[0][0] || same_lines(out) != 0)
+		return fail("parent and child drew the same numbers");
+
+	printf("== a deterministic context gives the same numbers\n");
+	if(!fork_draw("seed=0123456789abcdef0123456789abcdef", out))
+		return fail("execution failed");
+	if(!out[0][0] || strcmp(out[0], out[1]))
+		return fail("parent and child diverge with the same seed");
+
+	printf("= OK\n");
+	return 0;
+}